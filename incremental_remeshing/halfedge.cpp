@@ -3,6 +3,7 @@
 //
 
 #include "halfedge.hpp"
+#include "../marching_cubes/parallel.hpp"
 
 #include <glm/glm.hpp>
 
@@ -13,6 +14,9 @@
 #include <cassert>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <queue>
+#include <functional>
 
 void HalfEdgeMesh::reset() {
     vertex_positions.clear();
@@ -21,6 +25,9 @@ void HalfEdgeMesh::reset() {
     faces.clear();
     halfedges_opposite.clear();
     halfedges_vertex_to.clear();
+    deleted_faces.clear();
+    deleted_vertices.clear();
+    vertex_marks.clear();
 }
 
 int HalfEdgeMesh::get_next_halfedge(unsigned int const& halfedge_idx) {
@@ -163,80 +170,184 @@ void HalfEdgeMesh::delete_face(const unsigned int& he_idx) {
 }
 
 
-/* Iterates through one ring and returns vertex indices of those belonging to the given vertex's one ring */
-std::unordered_set<unsigned int> HalfEdgeMesh::get_one_ring_vertices(const unsigned int& vertex_idx) {
-    std::unordered_set<unsigned int> one_ring;
-    //Get first directed edge
-    int const& fde = vertex_outgoing_halfedge[vertex_idx];
-    one_ring.insert(halfedges_vertex_to[fde]);
-    int current_he_idx = get_previous_halfedge(fde);
-    assert(halfedges_vertex_to[current_he_idx] == vertex_idx);
-    while(fde != current_he_idx) {
-        unsigned int other_half = halfedges_opposite[current_he_idx];
-        if(other_half == fde) {
-            break;
-        }
-        one_ring.insert(halfedges_vertex_to[other_half]);
-        current_he_idx = get_previous_halfedge(other_half);
+/* Next outgoing halfedge around the vertex: the other half of the halfedge coming into it in the same face */
+OutgoingHalfedges::Iterator& OutgoingHalfedges::Iterator::operator++() {
+    int const other_half = mesh->halfedges_opposite[mesh->get_previous_halfedge(halfedge)];
+    halfedge = (other_half == first) ? -1 : other_half;
+    return *this;
+}
+
+/* Circulates around the vertex without allocating, from its first directed edge */
+OutgoingHalfedges HalfEdgeMesh::outgoing_halfedges(const unsigned int& vertex_idx) {
+    return OutgoingHalfedges{this, vertex_outgoing_halfedge[vertex_idx]};
+}
+
+/* Iterates through one ring and returns vertex indices of those belonging to the given vertex's one ring, in order around it.
+ * No memory is allocated below ONE_RING_CAPACITY vertices */
+OneRing HalfEdgeMesh::get_one_ring_vertices(const unsigned int& vertex_idx) {
+    OneRing one_ring;
+    for(int const halfedge : outgoing_halfedges(vertex_idx)) {
+        one_ring.push_back(halfedges_vertex_to[halfedge]);
     }
     return one_ring;
 }
 
-/* For each halfedge, find its other half */
-void HalfEdgeMesh::set_other_halves() {
-    unsigned int face_idx = 0;
-    for (unsigned int vertex_idx = 0; vertex_idx < faces.size(); vertex_idx += 3) {
-        //Find indices of its 3 halfedges
-        std::array<int, 3> halfedges = get_halfedges(face_idx);
-
-        //For each halfedge, find its other half i.e - the half edge in the opposite direction
-        /* The goal here is to find an edge that has the following: Given a halfedge edge E whose other half OE we are trying to find:
-         * -----> E's previous halfedge in the triangle will point TOWARDS E's FROM vertex.
-         *        Therefore:  ----> OE must point TOWARDS E's previous halfedge
-         * -----> The vertex E is pointing TOWARDS must be the same vertex OE's previous edge is pointing towards
-         *  We can successfully find a halfedge's other half by finding the edge that fulfills these requirements */
-
-        for (auto& halfedge: halfedges) {
-            int vertex_from = get_vertex_from(halfedge);
-
-            //Find all edges that point towards previous vertex (vertex from)
-            for (unsigned int otherhalf = 0; otherhalf < halfedges_vertex_to.size(); otherhalf++) {
-                if (halfedges_vertex_to[otherhalf] != vertex_from) {
-                    continue; //Not found candidate other half
-                }
-
-                //Check if this candidate halfedge is actually the other half
-                int vertex_to = halfedges_vertex_to[halfedge];
-                int vertex_to_candidate = halfedges_vertex_to[otherhalf];
-
-                int vertex_from_candidate = get_vertex_from(otherhalf);
-                if (vertex_from == vertex_to_candidate && vertex_to == vertex_from_candidate) {
-                    // Found other half
-                    halfedges_opposite[halfedge] = otherhalf;
-                    halfedges_opposite[otherhalf] = halfedge;
-                    break;
-                } else {
-                    continue;
-                }
+namespace {
+    /* Splits the vertices in contiguous chunks, a few per thread so uneven chunks balance out, and runs task(first, last) on
+     * every chunk on n_threads threads */
+    template<typename Task>
+    void parallel_for_vertex_chunks(std::size_t const& n_vertices, unsigned int const& n_threads, Task const& task) {
+        unsigned int const n_chunks = std::max<std::size_t>(1, std::min<std::size_t>(n_threads * 4, n_vertices));
+        parallel_for_slabs(n_chunks, n_threads, [&](unsigned int chunk) {
+            task(n_vertices * chunk / n_chunks, n_vertices * (chunk + 1) / n_chunks);
+        });
+    }
+}
+
+/* Number of edges around the vertex, counted without building its one ring */
+unsigned int HalfEdgeMesh::get_valence(const unsigned int& vertex_idx) {
+    unsigned int valence = 0;
+    for([[maybe_unused]] int const halfedge : outgoing_halfedges(vertex_idx)) {
+        valence++;
+    }
+    return valence;
+}
+
+/* Valences are counted in parallel, and give the offset of every vertex with a prefix sum. Then every vertex writes its own
+ * range of neighbours, so the rows are filled in parallel too */
+OneRingAdjacency HalfEdgeMesh::get_one_ring_adjacency(unsigned int const& n_threads) {
+    OneRingAdjacency adjacency;
+    std::size_t const n_vertices = vertex_positions.size();
+    adjacency.offsets.assign(n_vertices + 1, 0);
+    parallel_for_vertex_chunks(n_vertices, n_threads, [&](std::size_t first, std::size_t last) {
+        for(std::size_t vertex = first; vertex < last; vertex++) {
+            adjacency.offsets[vertex + 1] = get_valence(vertex);
+        }
+    });
+    for(std::size_t vertex = 0; vertex < n_vertices; vertex++) {
+        adjacency.offsets[vertex + 1] += adjacency.offsets[vertex];
+    }
+
+    adjacency.neighbours.resize(adjacency.offsets[n_vertices]);
+    parallel_for_vertex_chunks(n_vertices, n_threads, [&](std::size_t first, std::size_t last) {
+        for(std::size_t vertex = first; vertex < last; vertex++) {
+            unsigned int neighbour = adjacency.offsets[vertex];
+            for(int const halfedge : outgoing_halfedges(vertex)) {
+                adjacency.neighbours[neighbour++] = halfedges_vertex_to[halfedge];
+            }
+        }
+    });
+    return adjacency;
+}
+
+namespace {
+    struct HalfedgeKey {
+        std::uint64_t edge; // Both ends of the edge, lower vertex index in the upper 32 bits. The same for both halves
+        int halfedge;
+    };
+
+    std::uint64_t get_edge_key(unsigned int const& vertex_a, unsigned int const& vertex_b) {
+        return ((std::uint64_t)std::min(vertex_a, vertex_b) << 32) | std::max(vertex_a, vertex_b);
+    }
+
+    /* Stable LSD radix sort on the edge keys, 16 bits per pass. Vertex indices only use the low bits of each half of the key,
+     * so the digits that are 0 in every key are skipped: meshes under 65536 vertices take 2 passes */
+    void radix_sort_halfedges(std::vector<HalfedgeKey>& keys) {
+        constexpr int DIGIT_BITS = 16;
+        std::uint64_t used_bits = 0;
+        for(HalfedgeKey const& key : keys) used_bits |= key.edge;
+
+        std::vector<HalfedgeKey> sorted(keys.size());
+        std::vector<std::size_t> digit_start(1 << DIGIT_BITS);
+        for(int shift = 0; shift < 64; shift += DIGIT_BITS) {
+            std::uint64_t const digit_mask = (1u << DIGIT_BITS) - 1;
+            if(((used_bits >> shift) & digit_mask) == 0) continue;
+
+            std::fill(digit_start.begin(), digit_start.end(), 0);
+            for(HalfedgeKey const& key : keys) digit_start[(key.edge >> shift) & digit_mask]++;
+            std::size_t first = 0;
+            for(std::size_t& start : digit_start) {
+                std::size_t count = start;
+                start = first;
+                first += count;
             }
+            for(HalfedgeKey const& key : keys) sorted[digit_start[(key.edge >> shift) & digit_mask]++] = key;
+            keys.swap(sorted);
         }
-        face_idx++;
     }
 }
 
+/* For each halfedge, find its other half: the halfedge on the same edge, going the other way.
+ * Halfedges are radix sorted on a key of their edge, so all the halfedges of an edge end up next to each other, in O(H).
+ * An edge with a single halfedge is a boundary. An edge with more than two halfedges, or two in the same direction, is
+ * non-manifold: none of its halfedges can be paired consistently, so they are all left without other half */
+EdgePairingReport HalfEdgeMesh::set_other_halves() {
+    std::vector<HalfedgeKey> keys(halfedges_vertex_to.size());
+    for(unsigned int halfedge = 0; halfedge < keys.size(); halfedge++) {
+        keys[halfedge] = {get_edge_key(get_vertex_from(halfedge), halfedges_vertex_to[halfedge]), (int)halfedge};
+    }
+    radix_sort_halfedges(keys);
+
+    EdgePairingReport report;
+    halfedges_opposite.assign(halfedges_vertex_to.size(), -1);
+    for(std::size_t first = 0; first < keys.size();) {
+        std::size_t last = first + 1;
+        while(last < keys.size() && keys[last].edge == keys[first].edge) last++;
+
+        int const halfedge = keys[first].halfedge;
+        if(last - first == 1) {
+            report.boundary_halfedges.push_back(halfedge);
+        } else if(last - first == 2 && get_vertex_from(keys[first + 1].halfedge) == halfedges_vertex_to[halfedge]) {
+            int const other_half = keys[first + 1].halfedge;
+            halfedges_opposite[halfedge] = other_half;
+            halfedges_opposite[other_half] = halfedge;
+        } else {
+            for(std::size_t n = first; n < last; n++) report.non_manifold_halfedges.push_back(keys[n].halfedge);
+        }
+        first = last;
+    }
+    return report;
+}
+
+
+/* Creates the 3 halfedges of every face (halfedge n of a face goes from its vertex n to vertex n + 1), sets the outgoing
+ * halfedge of every vertex, and pairs the other halves */
+HalfEdgeMesh::HalfEdgeMesh(std::vector<glm::vec3> const& positions, std::vector<unsigned int> const& face_indices)
+        : vertex_positions(positions), vertex_outgoing_halfedge(positions.size(), -1), faces(face_indices) {
+    halfedges_opposite.assign(faces.size(), -1);
+    halfedges_vertex_to.resize(faces.size());
+
+    for(unsigned int face_start = 0; face_start < faces.size(); face_start += 3) {
+        for(unsigned int n = 0; n < 3; n++) {
+            unsigned int halfedge = face_start + n;
+            halfedges_vertex_to[halfedge] = faces[face_start + (n + 1) % 3];
+            vertex_outgoing_halfedge[faces[halfedge]] = halfedge;
+        }
+    }
+
+    std::cout << "Pairing other halves in mesh structure. "
+                 "Total n of halfedges: " << halfedges_opposite.size() << std::endl;
+    EdgePairingReport report = set_other_halves();
+    if(!report.boundary_halfedges.empty() || !report.non_manifold_halfedges.empty()) {
+        std::cout << "Found " << report.boundary_halfedges.size() << " boundary and "
+                  << report.non_manifold_halfedges.size() << " non-manifold halfedges" << std::endl;
+    }
+}
 
 /* Reads in an obj and returns a HalfEdgeMesh */
 HalfEdgeMesh obj_to_halfedge(char const* file_path) {
     //TODO: check for boundary to generalise
 
     std::cout << "Creating halfedge data structure from reconstructed surface" << std::endl;
-    HalfEdgeMesh mesh;
     std::ifstream obj_file(file_path);
     if (!obj_file.is_open()) {
         std::cerr << "Failed to open the file: " << file_path << std::endl;
         return HalfEdgeMesh{};
     }
 
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> faces;
     std::string line;
 
     while (std::getline(obj_file, line)) {
@@ -252,62 +363,26 @@ HalfEdgeMesh obj_to_halfedge(char const* file_path) {
         if (token == "v") { // Vertices
             glm::vec3 position;
             iss >> position.x >> position.y >> position.z;
-            mesh.vertex_positions.push_back(glm::vec3{
-                position.x,
-                position.y,
-                position.z
-            });
-            mesh.vertex_outgoing_halfedge.push_back(-1);
+            positions.push_back(position);
         } else if (token == "vn") { // Normals
             glm::vec3 normal;
             iss >> normal.x >> normal.y >> normal.z;
             // Assuming normals are listed in the same order as vertices
-            mesh.vertex_normals.push_back(
-                    glm::vec3 {
-                        normal.x,
-                        normal.y,
-                        normal.z
-                    }
-                    );
+            normals.push_back(normal);
         } else if (token == "f") { // Faces
             std::string vertex;
             while (iss >> vertex) {
                 std::istringstream vertex_idx_stream(vertex);
                 std::string index;
                 std::getline(vertex_idx_stream, index, '/'); // Read vertex index
-                mesh.faces.push_back(std::stoi(index) - 1); // OBJ indices are 1-based, convert to 0-based.
+                faces.push_back(std::stoi(index) - 1); // OBJ indices are 1-based, convert to 0-based.
             }
-
-            // For each face, create 3 halfedges.
-            unsigned int idx_2 = mesh.faces[ mesh.faces.size() - 1];
-            unsigned int idx_1 = mesh.faces[mesh.faces.size() - 2];
-            unsigned int idx_0 = mesh.faces[ mesh.faces.size() - 3];
-
-            // HalfEdge 0 - From vertex 0 to vertex 1
-            mesh.halfedges_opposite.push_back(-1);
-            mesh.halfedges_vertex_to.push_back(idx_1);
-            // Set vertex outgoing halfedge
-            mesh.vertex_outgoing_halfedge[idx_0] = mesh.halfedges_opposite.size() - 1;
-
-            // HalfEdge 1 - From vertex 1 to vertex 2
-            mesh.halfedges_opposite.push_back(-1);
-            mesh.halfedges_vertex_to.push_back(idx_2);
-            // Set vertex outgoing halfedge
-            mesh.vertex_outgoing_halfedge[idx_1] = mesh.halfedges_opposite.size() - 1;
-
-            // HalfEdge 2 - From vertex 2 to vertex 0
-            mesh.halfedges_opposite.push_back(-1);
-            mesh.halfedges_vertex_to.push_back(idx_0);
-            // Set vertex outgoing halfedge
-            mesh.vertex_outgoing_halfedge[idx_2] = mesh.halfedges_opposite.size() - 1;
         }
     }
     obj_file.close();
 
-    std::cout << "Pairing other halves in mesh structure. "
-                 "Total n of halfedges: " << mesh.halfedges_opposite.size() << std::endl;
-    mesh.set_other_halves();
-
+    HalfEdgeMesh mesh(positions, faces);
+    mesh.vertex_normals = std::move(normals);
     return mesh;
 }
 
@@ -335,18 +410,14 @@ bool HalfEdgeMesh::check_manifold(){
     }
 
     //Check for pinch point
+    //Number of half edges that have each vertex as endpoint.
+    std::vector<unsigned int> degrees(vertex_positions.size(), 0);
+    for(int const& vertex_to : halfedges_vertex_to) {
+        degrees[vertex_to]++;
+    }
     for(unsigned int vertex = 0; vertex < vertex_positions.size(); vertex++) {
-        //Check number of half edges that have this vertex as endpoint.
-        unsigned int degree = 0;
-        for(unsigned int j = 0; j < halfedges_vertex_to.size(); j++ ) {
-            if(halfedges_vertex_to[j] == vertex) {
-                degree++;
-                continue;
-            }
-        }
         //Check whether this number matches the vertex one ring
-        std::unordered_set<unsigned int> one_ring = get_one_ring_vertices(vertex);
-        if(degree != one_ring.size()) {
+        if(degrees[vertex] != get_valence(vertex)) {
          //Pinch point
          return 0;
         }
@@ -364,27 +435,27 @@ void HalfEdgeMesh::edge_split(const unsigned int& he_idx) {
     unsigned int const he_vertex_to = halfedges_vertex_to[he_idx];
 
     //Halfedge 1
-    unsigned int const& he_idx_1 = get_next_halfedge(he_idx);
-    unsigned int const& he_idx_1_vertex = halfedges_vertex_to[he_idx_1];
+    unsigned int const he_idx_1 = get_next_halfedge(he_idx);
+    unsigned int const he_idx_1_vertex = halfedges_vertex_to[he_idx_1];
     unsigned int const he_idx_1_opp = halfedges_opposite[he_idx_1]; // make a copy because this will be modified
 
 
     //Halfedge 2
-    unsigned int const& he_idx_2 = get_next_halfedge(he_idx_1);
-    unsigned int const& he_idx_2_vertex = halfedges_vertex_to[he_idx_2];
+    unsigned int const he_idx_2 = get_next_halfedge(he_idx_1);
+    unsigned int const he_idx_2_vertex = halfedges_vertex_to[he_idx_2];
 
     // Face 1 - the face which contains he_idx's opposite.
     //Halfedge 0
-    unsigned int const& he_opposite = halfedges_opposite[he_idx];
+    unsigned int const he_opposite = halfedges_opposite[he_idx];
     unsigned int he_opp_vertex_to = halfedges_vertex_to[he_opposite];
 
     //Halfedge 1
-    unsigned int const& he_opp_idx_1 =  get_next_halfedge(he_opposite);
-    unsigned int const& he_opp_1_vertex = halfedges_vertex_to[he_opp_idx_1];
+    unsigned int const he_opp_idx_1 =  get_next_halfedge(he_opposite);
+    unsigned int const he_opp_1_vertex = halfedges_vertex_to[he_opp_idx_1];
 
     //Halfedge 2
-    unsigned int const& he_opp_idx_2 =  get_next_halfedge(he_opp_idx_1);
-    unsigned int const& he_opp_2_vertex = halfedges_vertex_to[he_opp_idx_2];
+    unsigned int const he_opp_idx_2 =  get_next_halfedge(he_opp_idx_1);
+    unsigned int const he_opp_2_vertex = halfedges_vertex_to[he_opp_idx_2];
     unsigned int const he_opp_idx_2_opp = halfedges_opposite[he_opp_idx_2];  // make a copy because this will be modified
 
 
@@ -485,190 +556,191 @@ void HalfEdgeMesh::edge_split(const unsigned int& he_idx) {
  * or K has more than 3 vertices if either {i} or {j} are boundary vertices.
  *
  * In total this operation removes two triangles , one vertex & three edges (6 halfedges).
- * Removing triangles changes indexing in the face arrays & consequently the halfedge arrays. A way to
+ * Removed elements are only flagged (tombstones), so no index changes and the collapse only touches the one rings of both
+ * vertices. compact() removes them once the whole pass is done.
  *  Taken from:
  * Hoppe, H., Derose, T., Duchamp, T., Mcdonald, J. and Stuetzle, Mesh Optimization.
  * Available from: https://www.hhoppe.com/meshopt.pdf. */
 //TODO: check if boundary. Right now it is okay to not check as the input is assumed to be from Marching Cubes application (and therefore, manifold)
 bool HalfEdgeMesh::edge_collapse(const unsigned int& he_idx, const float& high_edge_length) {
-    unsigned int const& vertex_to = halfedges_vertex_to[he_idx];
+    unsigned int const vertex_to = halfedges_vertex_to[he_idx];
     unsigned int const vertex_from = get_vertex_from(he_idx);
 
-    //Iterate through one ring
-    std::unordered_set<unsigned int> p_onering = get_one_ring_vertices(vertex_from);
-    std::unordered_set<unsigned int> q_onering = get_one_ring_vertices(vertex_to);
-
+    //Third vertices of the two triangles on the edge
+    unsigned int const he_1_idx = get_next_halfedge(he_idx);
+    unsigned int const he_opposite_idx = halfedges_opposite[he_idx];
+    unsigned int const he_opp_idx_1 = get_next_halfedge(he_opposite_idx);
+    unsigned int const opposite_vertex_0 = halfedges_vertex_to[he_1_idx];
+    unsigned int const opposite_vertex_1 = halfedges_vertex_to[he_opp_idx_1];
 
+    //The two triangles must not share their third vertex (they would be the same triangle twice), and neither third vertex may
+    //have only 3 neighbours, as it would be left with 2: its two remaining faces would be on the same three vertices
+    if(opposite_vertex_0 == opposite_vertex_1 || get_valence(opposite_vertex_0) <= 3 || get_valence(opposite_vertex_1) <= 3) {
+        return false;
+    }
 
-    //Check for legality of operation
-    std::unordered_set<unsigned int> intersection;
-    for (const int& vertex : p_onering) {
-        if (q_onering.find(vertex) != q_onering.end()) {
-            intersection.insert(vertex);
+    //Check for legality of operation: the vertices adjacent to both ends must all form a triangle with the edge, ie. be the
+    //two third vertices. The one ring of vertex_from is marked, then the marked neighbours of vertex_to are counted (each once)
+    if(vertex_marks.size() < vertex_positions.size()) {
+        vertex_marks.resize(vertex_positions.size(), 0);
+    }
+    if(++vertex_mark == 0) { // Wrapped around, old marks could match again
+        std::fill(vertex_marks.begin(), vertex_marks.end(), 0);
+        vertex_mark = 1;
+    }
+    unsigned int valence_from = 0;
+    for(int const halfedge : outgoing_halfedges(vertex_from)) {
+        vertex_marks[halfedges_vertex_to[halfedge]] = vertex_mark;
+        valence_from++;
+    }
+    unsigned int valence_to = 0;
+    unsigned int n_shared_neighbours = 0;
+    for(int const halfedge : outgoing_halfedges(vertex_to)) {
+        unsigned int& mark = vertex_marks[halfedges_vertex_to[halfedge]];
+        if(mark == vertex_mark) {
+            n_shared_neighbours++;
+            mark = 0;
         }
+        valence_to++;
     }
-    //Add p & q to the intersection
-    intersection.insert(vertex_to);
-    intersection.insert(vertex_from);
-
-    //In order for edge collapse to be legal, vertices which belong to the intersection must form a triangle with v0 and v1 and the target edge
-    std::unordered_set<unsigned int> connected_vertices; // Vertices which form triangles with the target edge
-    connected_vertices.insert(vertex_to);
-
-    // Triangle belonging to he_idx
-    unsigned int const& he_1_idx = get_next_halfedge(he_idx);
-    connected_vertices.insert(halfedges_vertex_to[he_1_idx]);
-
-    unsigned int const& he_2_idx = get_next_halfedge(he_1_idx);
-    connected_vertices.insert(halfedges_vertex_to[he_2_idx]);
-
-    //Triangle belonging to he_opposite_idx
-    unsigned int const& he_opposite_idx = halfedges_opposite[he_idx];
-    connected_vertices.insert(halfedges_vertex_to[he_opposite_idx]);
-
-    unsigned int const& he_opp_idx_1 = get_next_halfedge(he_opposite_idx);
-    connected_vertices.insert(halfedges_vertex_to[he_opp_idx_1]);
-
-    unsigned int const& he_opp_idx_2 = get_next_halfedge(he_opp_idx_1);
-    connected_vertices.insert(halfedges_vertex_to[he_opp_idx_2]);
 
-    if(connected_vertices.size() != intersection.size()) {
-        //Illegal operation.
+    //Collapsing an edge of a tetrahedron would flatten it into two faces (both ends have only each other and the two third vertices)
+    if(valence_from <= 3 && valence_to <= 3) {
         return false;
     }
 
-    // Check if all elements are equal (they must be), if not it must mean there are more triangles connecting to p and q which
-    // do not form a triangle with edge pq
-    for (const int& vertex : intersection) {
-        if (connected_vertices.find(vertex) == connected_vertices.end()) {
-            return false;
-        }
+    if(n_shared_neighbours != 2) {
+        //Illegal operation: there are more triangles connecting to p and q which do not form a triangle with edge pq
+        return false;
     }
 
     //Even though edge collapse is legal, check whether collapsing this edge would produce a longer edge (and undo work done in edge split)
     //In order to check this, get the one ring of the vertex that will be deleted. Check what the distance is to the vertex where they will be connected.
     //If this is larger than the high threshold, do not carry out edge collapse.
-    for(unsigned int he = 0; he < halfedges_vertex_to.size(); he++)  {
-        if(halfedges_vertex_to[he] == vertex_from) {
-            //Check how long the edge would be with the new vertex.
-            unsigned int const& he_vertex_from = get_vertex_from(halfedges_vertex_to[he]);
-            glm::vec3 const& vertex_to_position = vertex_positions[vertex_to]; // Halfedge the collapsed edge points to. (i.e the vertex that will remain after the collapse)
-            glm::vec3 const& vertex_from_position = vertex_positions[he_vertex_from];
-            if(glm::distance(vertex_to_position,vertex_from_position) >= high_edge_length) {
-                return false; //Collapsing he_idx will create longer edges.
-            }
+    glm::vec3 const& vertex_to_position = vertex_positions[vertex_to]; // The vertex that will remain after the collapse
+    for(int const halfedge : outgoing_halfedges(vertex_from)) {
+        if(glm::distance(vertex_to_position, vertex_positions[halfedges_vertex_to[halfedge]]) >= high_edge_length) {
+            return false; //Collapsing he_idx will create longer edges.
         }
     }
+
+    //Halfedges pointing to the deleted vertex, found around its one ring before the connectivity changes
+    SmallVector<unsigned int, ONE_RING_CAPACITY> incoming_halfedges;
+    for(int const outgoing : outgoing_halfedges(vertex_from)) {
+        incoming_halfedges.push_back(get_previous_halfedge(outgoing));
+    }
+
     //Update data structure to reflect edge collapse
-    vertex_outgoing_halfedge[vertex_to] = halfedges_opposite[get_previous_halfedge(halfedges_opposite[he_idx])]; //To avoid clashes, set the fde to an edge which will NOT get collapsed.
+    //The surviving vertices of the two deleted triangles need outgoing halfedges outside them. The other halves of their edges
+    //are not deleted (the checks above ensure they are in other faces): vertex_to keeps its edge to opposite_vertex_1, and
+    //delete_face gives each opposite vertex its edge to vertex_to (vertex_from for opposite_vertex_1, redirected below)
+    int const vertex_to_outgoing = halfedges_opposite[get_previous_halfedge(he_opposite_idx)];
 
     //Flag the halfedges of the two triangles adjacent to the edge for deletion.
     //Triangle 0 - triangle belonging to the other half of the edge collapsed
     unsigned int deleted_face_0 = get_face(he_idx);
-    auto deleted_halfedges_0 = get_halfedges(deleted_face_0);
     delete_face(he_idx);
 
     //Triangle 1 - triangle belonging to the other half of the edge collapsed
     unsigned int deleted_face_1 = get_face(he_opposite_idx);
-    auto deleted_halfedges_1 = get_halfedges(deleted_face_1);
     delete_face(he_opposite_idx);
 
-    //Update halfedges pointing to the deleted vertex.
-    for(unsigned int halfedge = 0; halfedge < halfedges_vertex_to.size(); halfedge++) {
-        int& curr_vertex_to = halfedges_vertex_to[halfedge];
-        if(curr_vertex_to == -1) { continue; } // This halfedge is flagged for deletion, continue
-        if(curr_vertex_to == vertex_from) {
-            curr_vertex_to = vertex_to;
+    //Update halfedges pointing to the deleted vertex, and the faces they belong to.
+    for(unsigned int const& halfedge : incoming_halfedges) {
+        if(halfedges_vertex_to[halfedge] == -1) { continue; } // This halfedge is flagged for deletion, continue
+        halfedges_vertex_to[halfedge] = vertex_to;
+        unsigned int face = get_face(halfedge);
+        for(unsigned int vertex_idx = 0; vertex_idx < 3; vertex_idx++) {
+            if(faces[face*3 + vertex_idx] == vertex_from) {
+                faces[face*3 + vertex_idx] = vertex_to;
+            }
         }
     }
 
-    //Update halfedge indices
-    for(unsigned int halfedge = 0; halfedge < halfedges_opposite.size(); halfedge++) {
-        auto curr_he = halfedges_opposite[halfedge];
-        if(curr_he == -1) { continue; }
-        if(curr_he > deleted_halfedges_0[2]) { //If the idx of the opposite is above the deleted he index for face 0, shift by -3
-            halfedges_opposite[halfedge] -=3;
-        }
-        if(curr_he > deleted_halfedges_1[2]) { //If the idx of the opposite is above the deleted he index for face 1, shift by -3
-            halfedges_opposite[halfedge] -=3;
-        }
+    //Flag faces & vertex for deletion
+    for(unsigned int const& face : {deleted_face_0, deleted_face_1}) {
+        faces[face*3 + 0] = -1;
+        faces[face*3 + 1] = -1;
+        faces[face*3 + 2] = -1;
+        deleted_faces.push_back(face);
     }
-    for(unsigned int vertex = 0; vertex < vertex_outgoing_halfedge.size(); vertex++) {
-        auto outgoing_he = vertex_outgoing_halfedge[vertex];
-        assert(outgoing_he != -1); // All FDE should have been redirected beforehand if they were going to be deleted.
-        if(outgoing_he > deleted_halfedges_0[2]) { //If the idx of the opposite is above the deleted he index for face 0, shift by -3
-            vertex_outgoing_halfedge[vertex] -=3;
-        }
-        if(outgoing_he > deleted_halfedges_1[2]) { //If the idx of the opposite is above the deleted he index for face 1, shift by -3
-            vertex_outgoing_halfedge[vertex] -=3;
-        }
-    }
-
+    vertex_outgoing_halfedge[vertex_from] = -1;
+    deleted_vertices.push_back(vertex_from);
 
+    vertex_outgoing_halfedge[vertex_to] = vertex_to_outgoing;
+    for([[maybe_unused]] unsigned int const vertex : {vertex_to, opposite_vertex_0, opposite_vertex_1}) {
+        assert(halfedges_vertex_to[vertex_outgoing_halfedge[vertex]] != -1 && get_vertex_from(vertex_outgoing_halfedge[vertex]) == (int)vertex);
+    }
 
-    //Update faces - 2 will be deleted
-
-    faces[deleted_face_0*3 + 0] = -1;
-    faces[deleted_face_0*3 + 1] = -1;
-    faces[deleted_face_0*3 + 2] = -1;
+    return true;
 
-    faces[deleted_face_1*3 + 0] = -1;
-    faces[deleted_face_1*3 + 1] = -1;
-    faces[deleted_face_1*3 + 2] = -1;
+}
 
-    //Delete flagged faces
-    for (auto it = faces.begin(); it != faces.end();) {
-        // Check if the current face is flagged for deletion
-        if (*it == -1 && *(it + 1) == -1 && *(it + 2) == -1) {
-            // Erase the face (3 elements)
-            it = faces.erase(it, it + 3);
-        } else {
-            // Move to the next face
-            it += 3;
-        }
+/* Removes the faces (and their halfedges) and the vertices flagged for deletion, and renumbers the remaining ones in order.
+ * Every index stored in the mesh is remapped in one pass over the arrays */
+void HalfEdgeMesh::compact() {
+    if(deleted_faces.empty() && deleted_vertices.empty()) {
+        return;
     }
 
-    //Update vertex indices in faces
-    for(auto& vertex : faces ) {
-        if(vertex == vertex_from) {
-            vertex = vertex_to;
-        }
-        if(vertex > vertex_from) {
-            vertex--;
+    //New index of every vertex, -1 if deleted
+    std::vector<int> vertex_remap(vertex_positions.size(), 0);
+    for(unsigned int const& vertex : deleted_vertices) {
+        vertex_remap[vertex] = -1;
+    }
+    unsigned int n_vertices = 0;
+    for(int& new_vertex : vertex_remap) {
+        if(new_vertex != -1) {
+            new_vertex = n_vertices++;
         }
     }
 
-    //Update vertex indices in vertex_to
-    for(auto& vertex : halfedges_vertex_to) {
-        if(vertex == -1) { continue;}
-        if(vertex == vertex_from) {
-            vertex = vertex_to;
+    //New index of every halfedge, -1 if deleted. Halfedges keep their position within their face
+    std::vector<int> halfedge_remap(halfedges_vertex_to.size(), 0);
+    for(unsigned int const& face : deleted_faces) {
+        for(int const& halfedge : get_halfedges(face)) {
+            halfedge_remap[halfedge] = -1;
         }
-        if(vertex > vertex_from) {
-            vertex--;
+    }
+    unsigned int n_halfedges = 0;
+    for(int& new_halfedge : halfedge_remap) {
+        if(new_halfedge != -1) {
+            new_halfedge = n_halfedges++;
         }
     }
 
-    //Remove vertex
-    vertex_positions.erase(vertex_positions.begin() + vertex_from);
-    vertex_outgoing_halfedge.erase(vertex_outgoing_halfedge.begin() + vertex_from);
-
-    //Remove halfedges
-    auto it_opposite = halfedges_opposite.begin();
-    auto it_vertex_to = halfedges_vertex_to.begin();
-
-    while (it_opposite != halfedges_opposite.end() && it_vertex_to != halfedges_vertex_to.end()) {
-        if (*it_opposite == -1 || *it_vertex_to == -1) {
-            it_opposite = halfedges_opposite.erase(it_opposite);
-            it_vertex_to = halfedges_vertex_to.erase(it_vertex_to);
-        } else {
-            ++it_opposite;
-            ++it_vertex_to;
+    bool const has_normals = vertex_normals.size() == vertex_positions.size();
+    for(unsigned int vertex = 0; vertex < vertex_remap.size(); vertex++) {
+        if(vertex_remap[vertex] == -1) { continue; }
+        int const outgoing_he = vertex_outgoing_halfedge[vertex];
+        assert(outgoing_he == -1 || halfedge_remap[outgoing_he] != -1); // All FDE should have been redirected beforehand if they were going to be deleted.
+        vertex_positions[vertex_remap[vertex]] = vertex_positions[vertex];
+        if(has_normals) {
+            vertex_normals[vertex_remap[vertex]] = vertex_normals[vertex];
         }
+        vertex_outgoing_halfedge[vertex_remap[vertex]] = (outgoing_he == -1) ? -1 : halfedge_remap[outgoing_he];
+    }
+    vertex_positions.resize(n_vertices);
+    vertex_outgoing_halfedge.resize(n_vertices);
+    if(has_normals) {
+        vertex_normals.resize(n_vertices);
     }
 
-    return true;
+    //Faces are stored with their halfedges, so both are moved together
+    for(unsigned int halfedge = 0; halfedge < halfedge_remap.size(); halfedge++) {
+        int const new_halfedge = halfedge_remap[halfedge];
+        if(new_halfedge == -1) { continue; }
+        int const opposite = halfedges_opposite[halfedge];
+        faces[new_halfedge] = vertex_remap[faces[halfedge]];
+        halfedges_vertex_to[new_halfedge] = vertex_remap[halfedges_vertex_to[halfedge]];
+        halfedges_opposite[new_halfedge] = (opposite == -1) ? -1 : halfedge_remap[opposite];
+    }
+    faces.resize(n_halfedges);
+    halfedges_vertex_to.resize(n_halfedges);
+    halfedges_opposite.resize(n_halfedges);
 
+    deleted_faces.clear();
+    deleted_vertices.clear();
 }
 
 
@@ -771,47 +843,121 @@ void HalfEdgeMesh::split_long_edges(const float& high_edge_length) {
 
 /* Performs halfedge collapse on edges shorter than the threshold low_edge_length.
  * The algorithm might create edges which are long and undo the work during the edge split so this function
- * checks whether that would happen before performing the split. */
+ * checks whether that would happen before performing the split.
+ * Collapsed elements are only flagged during the pass, and removed all at once at the end (see compact) */
 void HalfEdgeMesh::collapse_short_edges(const float& high_edge_length, const float& low_edge_length) {
-    unsigned int edge = 0;
-    while (edge < halfedges_vertex_to.size()) {
+    for(unsigned int edge = 0; edge < halfedges_vertex_to.size(); edge++) {
+        if (halfedges_vertex_to[edge] == -1) {
+            continue; // Deleted by an earlier collapse
+        }
         if (get_edge_length(edge) >= low_edge_length) {
-            edge++;
             continue;
         }
-        bool collapsed = edge_collapse(edge, high_edge_length);
-        if(!collapsed) {edge++;}
+        edge_collapse(edge, high_edge_length);
+    }
+    compact();
+}
 
+/* Same as split_long_edges, longest edge first. Every edge is queued once (on its halfedge with the lower index) with its
+ * length when queued, so an entry whose halfedge changed length since is stale and skipped. A split only changes the faces
+ * around the new vertex: their edges are queued again (the outer ones may have moved to a new halfedge), and the rest of
+ * the mesh is never looked at twice. Returns the number of edges split */
+unsigned int HalfEdgeMesh::split_long_edges_queued(const float& high_edge_length) {
+    std::priority_queue<std::pair<float, int>> queue; // Longest on top
+    auto queue_edge = [&](int const& halfedge) {
+        int const edge = std::min(halfedge, halfedges_opposite[halfedge]);
+        float const edge_length = get_edge_length(edge);
+        if(edge_length >= high_edge_length) {
+            queue.emplace(edge_length, edge);
+        }
+    };
+    for(unsigned int halfedge = 0; halfedge < halfedges_vertex_to.size(); halfedge++) {
+        if((int)halfedge < halfedges_opposite[halfedge]) {
+            queue_edge(halfedge);
+        }
     }
+
+    unsigned int n_splits = 0;
+    while(!queue.empty()) {
+        auto const [edge_length, edge] = queue.top();
+        queue.pop();
+        if(get_edge_length(edge) != edge_length) {
+            continue; // Changed by an earlier split, and queued again then
+        }
+        edge_split(edge);
+        n_splits++;
+        for(int const halfedge : outgoing_halfedges(vertex_positions.size() - 1)) {
+            queue_edge(halfedge);
+            queue_edge(get_next_halfedge(halfedge));
+        }
+    }
+    return n_splits;
+}
+
+/* Same as collapse_short_edges, shortest edge first, queued like in split_long_edges_queued. Each edge is tried in both
+ * directions when it is popped. A collapse changes the edges around the remaining vertex, so only those are queued again.
+ * Returns the number of edges collapsed */
+unsigned int HalfEdgeMesh::collapse_short_edges_queued(const float& high_edge_length, const float& low_edge_length) {
+    std::priority_queue<std::pair<float, int>, std::vector<std::pair<float, int>>, std::greater<>> queue; // Shortest on top
+    auto queue_edge = [&](int const& halfedge) {
+        int const edge = std::min(halfedge, halfedges_opposite[halfedge]);
+        float const edge_length = get_edge_length(edge);
+        if(edge_length < low_edge_length) {
+            queue.emplace(edge_length, edge);
+        }
+    };
+    for(unsigned int halfedge = 0; halfedge < halfedges_vertex_to.size(); halfedge++) {
+        if((int)halfedge < halfedges_opposite[halfedge]) {
+            queue_edge(halfedge);
+        }
+    }
+
+    unsigned int n_collapses = 0;
+    while(!queue.empty()) {
+        auto const [edge_length, edge] = queue.top();
+        queue.pop();
+        if(halfedges_vertex_to[edge] == -1 || get_edge_length(edge) != edge_length) {
+            continue; // Deleted or changed by an earlier collapse
+        }
+        unsigned int const vertex_to = halfedges_vertex_to[edge];
+        unsigned int const vertex_from = get_vertex_from(edge);
+        unsigned int remaining_vertex;
+        if(edge_collapse(edge, high_edge_length)) {
+            remaining_vertex = vertex_to;
+        } else if(edge_collapse(halfedges_opposite[edge], high_edge_length)) {
+            remaining_vertex = vertex_from;
+        } else {
+            continue;
+        }
+        n_collapses++;
+        for(int const halfedge : outgoing_halfedges(remaining_vertex)) {
+            queue_edge(halfedge);
+            queue_edge(get_next_halfedge(halfedge));
+        }
+    }
+    compact();
+    return n_collapses;
 }
 
 /* Equalizes vertex valences by flipping edges.
  * Checks whether the deviation to the target valence decreases, if not, edge is flipped back */
 void HalfEdgeMesh::equalize_valences() {
-    auto get_deviation = [this](std::unordered_set<unsigned int>& vertices) -> int {
+    //The four vertices of the two triangles adjacent to the edge. A flip only changes their valences
+    auto get_deviation = [this](std::array<unsigned int, 4> const& vertices) -> int {
         int deviation = 0;
         for(auto const& vertex : vertices) {
-            deviation += abs(get_one_ring_vertices(vertex).size() - INTERIOR_TARGET_VALENCE);
+            deviation += std::abs((int)get_valence(vertex) - (int)INTERIOR_TARGET_VALENCE);
         }
         return deviation;
     };
 
     for(unsigned int edge = 0; edge < halfedges_vertex_to.size(); edge++ ) {
-        unsigned int face_0 = get_face(edge);
-        unsigned int face_1 = get_face(halfedges_opposite[edge]);
-
-        //Get vertices of two triangles adjacent to halfedges
-        auto vertices_0 = get_face_vertices(face_0);
-        auto vertices_1 = get_face_vertices(face_1);
-
-        std::unordered_set<unsigned int> unique_vertices;
-        for(auto const& vertex : vertices_0) {
-            unique_vertices.insert(vertex);
-
-        }
-        for(auto const& vertex : vertices_1) {
-            unique_vertices.insert(vertex);
-        }
+        std::array<unsigned int, 4> const unique_vertices = {
+            (unsigned int)get_vertex_from(edge),
+            (unsigned int)halfedges_vertex_to[edge],
+            (unsigned int)halfedges_vertex_to[get_next_halfedge(edge)],
+            (unsigned int)halfedges_vertex_to[get_next_halfedge(halfedges_opposite[edge])]
+        };
 
         int pre_flip_deviation = get_deviation(unique_vertices);
 
@@ -847,6 +993,39 @@ void HalfEdgeMesh::tangential_relaxation() {
 
 
 
+/* Jacobi version of tangential_relaxation: relaxed positions are written to a second buffer, which replaces the positions
+ * once every vertex is done. Each vertex only reads the old positions of its one ring, from the CSR adjacency, and writes
+ * its own relaxed position, so the vertices are split across threads and the result is the same on any number of them.
+ * Coordinates are summed separately over the contiguous row of neighbours */
+void HalfEdgeMesh::tangential_relaxation_jacobi(unsigned int const& n_threads) {
+    OneRingAdjacency const adjacency = get_one_ring_adjacency(n_threads);
+    std::vector<glm::vec3> relaxed_positions(vertex_positions.size());
+
+    parallel_for_vertex_chunks(vertex_positions.size(), n_threads, [&](std::size_t first, std::size_t last) {
+        for(std::size_t vertex_idx = first; vertex_idx < last; vertex_idx++) {
+            glm::vec3 const& position = vertex_positions[vertex_idx];
+            unsigned int const row_begin = adjacency.offsets[vertex_idx];
+            unsigned int const row_end = adjacency.offsets[vertex_idx + 1];
+            if(row_begin == row_end) {
+                relaxed_positions[vertex_idx] = position; // No one ring to move towards
+                continue;
+            }
+
+            float sum_x = 0.0f, sum_y = 0.0f, sum_z = 0.0f;
+            for(unsigned int neighbour = row_begin; neighbour < row_end; neighbour++) {
+                glm::vec3 const& neighbour_position = vertex_positions[adjacency.neighbours[neighbour]];
+                sum_x += neighbour_position.x;
+                sum_y += neighbour_position.y;
+                sum_z += neighbour_position.z;
+            }
+            glm::vec3 const barycentre = glm::vec3{sum_x, sum_y, sum_z} / (float)(row_end - row_begin);
+            glm::vec3 const& normal = vertex_normals[vertex_idx];
+            relaxed_positions[vertex_idx] = barycentre + glm::dot(normal, (position - barycentre)) * normal;
+        }
+    });
+    vertex_positions.swap(relaxed_positions);
+}
+
 /* Performs remeshing according to procedures described in
  * Botsch, M. and Kobbelt, L. 2004. A remeshing approach to multiresolution modeling.
  * This consists of the following operations:
@@ -854,8 +1033,11 @@ void HalfEdgeMesh::tangential_relaxation() {
  * - Split long edges
  * - Collapse short edges
  * - Tangential relaxation (smooth mesh without deformation)
+ * With use_priority_queue, edges are split longest first and collapsed shortest first (see split_long_edges_queued)
+ * With jacobi_relaxation, the tangential relaxation moves all vertices at once on n_threads threads (see tangential_relaxation_jacobi)
  * Another description of the algorithm can be seen at: Botsch, M. 2010. Polygon mesh processing. Natick, Mass.: A K Peters. pages 100 - 102*/
-void HalfEdgeMesh::remesh(float const& input_target_edge_length, unsigned int const& n_iterations) {
+void HalfEdgeMesh::remesh(float const& input_target_edge_length, unsigned int const& n_iterations, bool const& use_priority_queue,
+                          bool const& jacobi_relaxation, unsigned int const& n_threads) {
     float target_edge_length;
     if(input_target_edge_length == 0) {
         target_edge_length = get_mean_edge_length();
@@ -866,15 +1048,25 @@ void HalfEdgeMesh::remesh(float const& input_target_edge_length, unsigned int co
     float high = (4.0f/3.0f) * target_edge_length; // are essential to converge to a uniform edge length
 
     for(unsigned int remeshing_iterations = 0; remeshing_iterations < n_iterations; remeshing_iterations++) {
-        split_long_edges(high);
+        if(use_priority_queue) {
+            split_long_edges_queued(high);
+
+            collapse_short_edges_queued(high, low);
+        } else {
+            split_long_edges(high);
 
-        collapse_short_edges(high, low);
+            collapse_short_edges(high, low);
+        }
 
         equalize_valences();
 
         calculate_normals();
 
-        tangential_relaxation();
+        if(jacobi_relaxation) {
+            tangential_relaxation_jacobi(n_threads);
+        } else {
+            tangential_relaxation();
+        }
     }
 }
 
@@ -7,13 +7,52 @@
 
 constexpr unsigned int INTERIOR_TARGET_VALENCE = 6;
 constexpr unsigned int BOUNDARY_TARGET_VALENCE = 4; //This will be unused since manifold meshes do NOT have boundaries
+constexpr unsigned int ONE_RING_CAPACITY = 16; // One rings up to this valence are stored without allocating
 
 
 #include <vector>
 #include <array>
-#include <unordered_set>
 #include <glm/vec3.hpp>
 
+#include "small_vector.hpp"
+
+struct IndexedMesh;
+struct HalfEdgeMesh;
+
+using OneRing = SmallVector<unsigned int, ONE_RING_CAPACITY>;
+
+// Outgoing halfedges of a vertex, in order around it, starting at its outgoing halfedge (see HalfEdgeMesh::outgoing_halfedges).
+// Stops early at a halfedge without other half
+struct OutgoingHalfedges {
+    struct Iterator {
+        HalfEdgeMesh* mesh;
+        int first;
+        int halfedge; // -1 once the whole ring has been visited
+
+        int operator*() const { return halfedge; }
+        bool operator!=(Iterator const& other) const { return halfedge != other.halfedge; }
+        Iterator& operator++();
+    };
+
+    HalfEdgeMesh* mesh;
+    int first;
+
+    Iterator begin() const { return {mesh, first, first}; }
+    Iterator end() const { return {mesh, first, -1}; }
+};
+
+// One ring of every vertex in compressed sparse rows: the neighbours of vertex v are neighbours[offsets[v]] up to
+// neighbours[offsets[v + 1]], in order around it
+struct OneRingAdjacency {
+    std::vector<unsigned int> offsets; // One entry per vertex, plus the total
+    std::vector<unsigned int> neighbours;
+};
+
+// Edges found while pairing the other halves (see HalfEdgeMesh::set_other_halves)
+struct EdgePairingReport {
+    std::vector<int> boundary_halfedges; // Halfedges alone on their edge
+    std::vector<int> non_manifold_halfedges; // Halfedges of edges with more than two faces, or two faces with opposite orientations
+};
 
 struct HalfEdgeMesh {
     // Vertex information
@@ -26,13 +65,31 @@ struct HalfEdgeMesh {
     std::vector<int> halfedges_opposite; //aka. other halves
     std::vector<int> halfedges_vertex_to;
 
+    // Faces and vertices deleted by edge_collapse. They are left in the arrays, flagged with -1, until compact() removes them.
+    // These are deletion logs for compact(), not free lists: both collapse passes compact before returning, so edge_split
+    // never sees a freed slot and always appends
+    std::vector<unsigned int> deleted_faces;
+    std::vector<unsigned int> deleted_vertices;
+
+    // Scratch for the legality test of edge_collapse: a vertex is marked when vertex_marks[vertex] == vertex_mark
+    std::vector<unsigned int> vertex_marks;
+    unsigned int vertex_mark = 0;
+
     //Mesh metrics
     float average_triangle_area;
     float triangle_area_range;
     float mean_triangle_aspect_ratio;
     float triangle_area_standard_deviation;
 
-    void set_other_halves();
+    HalfEdgeMesh() = default;
+    // Builds the halfedges, their other halves and the outgoing halfedges of a triangle mesh. Every 3 face indices are a face
+    HalfEdgeMesh(std::vector<glm::vec3> const& positions, std::vector<unsigned int> const& face_indices);
+    // Same as above, straight from the marching cubes output (defined with IndexedMesh)
+    explicit HalfEdgeMesh(IndexedMesh const& indexedMesh);
+
+    // Pairs every halfedge with the one going the other way along the same edge, in linear time. Halfedges without a
+    // (unique) other half are left at -1 and reported
+    EdgePairingReport set_other_halves();
     bool check_manifold();
     void reset();
 
@@ -44,7 +101,10 @@ struct HalfEdgeMesh {
     float get_edge_length(unsigned int const& halfedge);
     int get_face(unsigned int const& halfedge);
     std::array<unsigned int, 3 > get_face_vertices(unsigned int const& face);
-    std::unordered_set<unsigned int> get_one_ring_vertices(unsigned int const& vertex_idx);
+    OutgoingHalfedges outgoing_halfedges(unsigned int const& vertex_idx);
+    OneRing get_one_ring_vertices(unsigned int const& vertex_idx);
+    unsigned int get_valence(unsigned int const& vertex_idx);
+    OneRingAdjacency get_one_ring_adjacency(unsigned int const& n_threads = 1);
 
     void calculate_normals();
 
@@ -53,16 +113,27 @@ struct HalfEdgeMesh {
     bool edge_collapse(unsigned int const& edge_idx, const float& high_edge_length);
     void edge_split(unsigned int const& edge_idx);
     void edge_flip(unsigned int const& edge_idx);
+    void compact();
 
     //Incremental remeshing operations
     float get_mean_edge_length();
     void split_long_edges(const float& high_edge_length);
     void collapse_short_edges(const float& high_edge_length, const float& low_edge_length);
+    // Same as above, driven by a priority queue of edge lengths: longest (shortest) first, and only the edges changed by an
+    // operation are looked at again. Return the number of operations
+    unsigned int split_long_edges_queued(const float& high_edge_length);
+    unsigned int collapse_short_edges_queued(const float& high_edge_length, const float& low_edge_length);
     void equalize_valences();
     void tangential_relaxation();
+    // Same as above, but every vertex moves from the positions before the sweep (Jacobi), so the result does not depend on
+    // the vertex order and vertices are relaxed on n_threads threads
+    void tangential_relaxation_jacobi(unsigned int const& n_threads = 1);
     void project_to_surface();
 
-    void remesh(float const& input_target_edge_length, unsigned int const& n_iterations);
+    // With use_priority_queue, splits and collapses use the queued passes above. With jacobi_relaxation, the tangential
+    // relaxation runs on n_threads threads (see tangential_relaxation_jacobi)
+    void remesh(float const& input_target_edge_length, unsigned int const& n_iterations, bool const& use_priority_queue = false,
+                bool const& jacobi_relaxation = false, unsigned int const& n_threads = 1);
 
     //Mesh metrics
     float calculate_hausdorff_distance(std::vector<glm::vec3> const& original_points);
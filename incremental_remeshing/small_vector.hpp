@@ -0,0 +1,55 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_SMALL_VECTOR_HPP
+#define MARCHING_CUBES_POINT_CLOUD_SMALL_VECTOR_HPP
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+/* Vector of trivially copyable values that stores its first N values inline, so it does not allocate unless it grows past N.
+ * Past N, every value is moved to the heap and stays there. Meant for small per-vertex lists such as one rings */
+template<typename T, std::size_t N>
+class SmallVector {
+public:
+    void push_back(T const& value) {
+        if(count < N) {
+            inline_values[count] = value;
+        } else {
+            if(count == N) {
+                heap_values.assign(inline_values.begin(), inline_values.end());
+            }
+            heap_values.push_back(value);
+        }
+        count++;
+    }
+
+    // Adds the value if it is not in the vector yet, so the vector can be used as a small set. True if it was added
+    void clear() {
+        count = 0;
+        heap_values.clear();
+    }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T* data() { return (count <= N) ? inline_values.data() : heap_values.data(); }
+    T const* data() const { return (count <= N) ? inline_values.data() : heap_values.data(); }
+    T& operator[](std::size_t const& index) { return data()[index]; }
+    T const& operator[](std::size_t const& index) const { return data()[index]; }
+
+    T* begin() { return data(); }
+    T* end() { return data() + count; }
+    T const* begin() const { return data(); }
+    T const* end() const { return data() + count; }
+
+private:
+    std::size_t count = 0;
+    std::array<T, N> inline_values;
+    std::vector<T> heap_values; // Holds every value once count > N
+};
+
+#endif //MARCHING_CUBES_POINT_CLOUD_SMALL_VECTOR_HPP
@@ -0,0 +1,115 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "case_index.hpp"
+#include "surface_reconstruction.hpp"
+
+#include <vector>
+#include <cstring>
+
+// The vector kernels use per-function target attributes, so they are built even if the rest of the code is not compiled
+// for AVX2, and only run if the CPU supports them
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CASE_INDEX_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define CASE_INDEX_X86_KERNELS 0
+#endif
+
+namespace {
+    // Bit of the case index set by bit n (shift 0) and bit n + 1 (shift 1) of each row, for cube n (see get_case)
+    constexpr std::uint8_t corner_bits[4][2] = {{1u << 0, 1u << 2}, {1u << 1, 1u << 3}, {1u << 4, 1u << 6}, {1u << 5, 1u << 7}};
+
+    void get_chunk_cases_scalar(std::uint64_t const (&row_bits)[4], std::uint8_t (&cases)[CASE_CHUNK_SIZE]) {
+        for(int cube = 0; cube < CASE_CHUNK_SIZE; cube++) {
+            cases[cube] = get_case((row_bits[0] >> cube) & 3u, (row_bits[1] >> cube) & 3u,
+                                   (row_bits[2] >> cube) & 3u, (row_bits[3] >> cube) & 3u);
+        }
+    }
+
+#if CASE_INDEX_X86_KERNELS
+    /* Every bit of the row becomes one byte: each byte is loaded with the byte of the row holding its bit (shuffle), and compared
+     * to a mask of that bit alone. Bytes are 0xFF if the bit is set, then masked to the bit of the case index the row sets.
+     * The case indices of 32 cubes are ORed together from the 8 shifted rows */
+    __attribute__((target("avx2")))
+    void get_chunk_cases_avx2(std::uint64_t const (&row_bits)[4], std::uint8_t (&cases)[CASE_CHUNK_SIZE]) {
+        __m256i const byte_of_bit = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                     2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        __m256i const bit_of_byte = _mm256_set1_epi64x(0x8040201008040201);
+        for(int half = 0; half < 2; half++) {
+            __m256i case_indices = _mm256_setzero_si256();
+            for(int row = 0; row < 4; row++) {
+                for(int shift = 0; shift < 2; shift++) {
+                    auto bits = (std::uint32_t)(row_bits[row] >> (32 * half + shift));
+                    __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int)bits), byte_of_bit);
+                    __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bit_of_byte), bit_of_byte);
+                    case_indices = _mm256_or_si256(case_indices, _mm256_and_si256(set, _mm256_set1_epi8((char)corner_bits[row][shift])));
+                }
+            }
+            _mm256_storeu_si256((__m256i*)&cases[32 * half], case_indices);
+        }
+    }
+
+    // Same as the AVX2 kernel, 16 cubes at a time
+    __attribute__((target("sse4.1")))
+    void get_chunk_cases_sse41(std::uint64_t const (&row_bits)[4], std::uint8_t (&cases)[CASE_CHUNK_SIZE]) {
+        __m128i const byte_of_bit = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+        __m128i const bit_of_byte = _mm_set1_epi64x(0x8040201008040201);
+        for(int quarter = 0; quarter < 4; quarter++) {
+            __m128i case_indices = _mm_setzero_si128();
+            for(int row = 0; row < 4; row++) {
+                for(int shift = 0; shift < 2; shift++) {
+                    auto bits = (std::uint32_t)(row_bits[row] >> (16 * quarter + shift));
+                    __m128i bytes = _mm_shuffle_epi8(_mm_set1_epi32((int)bits), byte_of_bit);
+                    __m128i set = _mm_cmpeq_epi8(_mm_and_si128(bytes, bit_of_byte), bit_of_byte);
+                    case_indices = _mm_or_si128(case_indices, _mm_and_si128(set, _mm_set1_epi8((char)corner_bits[row][shift])));
+                }
+            }
+            _mm_storeu_si128((__m128i*)&cases[16 * quarter], case_indices);
+        }
+    }
+#endif
+
+    struct CaseIndexKernel {
+        void (*function)(std::uint64_t const (&)[4], std::uint8_t (&)[CASE_CHUNK_SIZE]);
+        char const* name;
+    };
+
+    // Every kernel the CPU can run, widest first
+    std::vector<CaseIndexKernel> const& get_supported_kernels() {
+        static std::vector<CaseIndexKernel> const kernels = [] {
+            std::vector<CaseIndexKernel> supported;
+#if CASE_INDEX_X86_KERNELS
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2")) supported.push_back({get_chunk_cases_avx2, "avx2"});
+            if(__builtin_cpu_supports("sse4.1")) supported.push_back({get_chunk_cases_sse41, "sse4.1"});
+#endif
+            supported.push_back({get_chunk_cases_scalar, "scalar"});
+            return supported;
+        }();
+        return kernels;
+    }
+
+    CaseIndexKernel const& get_kernel() {
+        return get_supported_kernels().front();
+    }
+}
+
+void get_chunk_cases(std::uint64_t const (&row_bits)[4], std::uint8_t (&cases)[CASE_CHUNK_SIZE]) {
+    get_kernel().function(row_bits, cases);
+}
+
+char const* case_index_kernel_name() {
+    return get_kernel().name;
+}
+
+bool get_chunk_cases(char const* kernel_name, std::uint64_t const (&row_bits)[4], std::uint8_t (&cases)[CASE_CHUNK_SIZE]) {
+    for(auto const& kernel : get_supported_kernels()) {
+        if(std::strcmp(kernel.name, kernel_name) == 0) {
+            kernel.function(row_bits, cases);
+            return true;
+        }
+    }
+    return false;
+}
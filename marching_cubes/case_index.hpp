@@ -0,0 +1,25 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_CASE_INDEX_HPP
+#define MARCHING_CUBES_POINT_CLOUD_CASE_INDEX_HPP
+
+#include <cstdint>
+
+constexpr int CASE_CHUNK_SIZE = 64; // Cubes written by get_chunk_cases
+
+// Case indices of a run of consecutive cubes along k, from the classification of their four rows of vertices
+// (i, j), (i, j+1), (i+1, j), (i+1, j+1), with the vertex at the first cube's k in bit 0 (see get_case).
+// Cube n uses bits n and n + 1 of every row, so only the cubes whose bits are all inside the rows are meaningful.
+// Uses the widest kernel the CPU supports (AVX2, SSE4.1 or scalar), picked once at startup
+void get_chunk_cases(std::uint64_t const (&row_bits)[4], std::uint8_t (&cases)[CASE_CHUNK_SIZE]);
+
+// Name of the kernel used by get_chunk_cases: "avx2", "sse4.1" or "scalar"
+char const* case_index_kernel_name();
+
+// Same as get_chunk_cases, with the named kernel instead of the widest one, so the kernels can be checked against each other.
+// False (and cases is not written) if the kernel is not built or the CPU does not support it
+bool get_chunk_cases(char const* kernel_name, std::uint64_t const (&row_bits)[4], std::uint8_t (&cases)[CASE_CHUNK_SIZE]);
+
+#endif //MARCHING_CUBES_POINT_CLOUD_CASE_INDEX_HPP
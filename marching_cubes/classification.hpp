@@ -0,0 +1,73 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_CLASSIFICATION_HPP
+#define MARCHING_CUBES_POINT_CLOUD_CLASSIFICATION_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/* Bit-packed classification of the grid vertices. 1 bit per vertex: 0 - negative, 1 - positive.
+ * Vertex v is bit v % 64 of word v / 64, so consecutive vertices (along k) are consecutive bits. */
+struct VertexClassification {
+    std::vector<std::uint64_t> words;
+    std::size_t vertex_count = 0;
+
+    VertexClassification() = default;
+    explicit VertexClassification(std::size_t n_vertices) : words((n_vertices + 63) / 64, 0), vertex_count(n_vertices) {}
+
+    std::size_t size() const { return vertex_count; }
+
+    unsigned int operator[](std::size_t vertex) const {
+        return (words[vertex / 64] >> (vertex % 64)) & 1u;
+    }
+
+    void set(std::size_t vertex, unsigned int value) {
+        std::uint64_t bit = std::uint64_t{1} << (vertex % 64);
+        words[vertex / 64] = value ? (words[vertex / 64] | bit) : (words[vertex / 64] & ~bit);
+    }
+
+    // Classification of count (<= 57) consecutive vertices starting at first_vertex, first_vertex in bit 0.
+    // The bits may straddle two words.
+    std::uint64_t get_bits(std::size_t first_vertex, unsigned int count) const {
+        std::size_t word = first_vertex / 64;
+        unsigned int offset = first_vertex % 64;
+        std::uint64_t bits = words[word] >> offset;
+        if(offset + count > 64) {
+            bits |= words[word + 1] << (64 - offset);
+        }
+        return bits & ((std::uint64_t{1} << count) - 1);
+    }
+};
+
+/* Bit-packed classification of the grid edges. 2 bits per edge: 0 - negative, 1 - positive, 2 - bipolar.
+ * Edges are stored in the order they are classified in, which is the order of the grid edge list. */
+struct EdgeClassification {
+    std::vector<std::uint64_t> words;
+    std::size_t edge_count = 0;
+
+    std::size_t size() const { return edge_count; }
+
+    unsigned int operator[](std::size_t edge) const {
+        return (words[edge / 32] >> (2 * (edge % 32))) & 3u;
+    }
+
+    void reserve(std::size_t n_edges) {
+        words.reserve((n_edges + 31) / 32);
+    }
+
+    void push_back(unsigned int value) {
+        if(edge_count % 32 == 0) words.push_back(0);
+        words.back() |= std::uint64_t{value} << (2 * (edge_count % 32));
+        edge_count++;
+    }
+
+    // Edge value from the classification of its two ends, without branches. Equal ends give their value, else bipolar (2)
+    static unsigned int get_edge_value(unsigned int v1, unsigned int v2) {
+        return (v1 & v2) | ((v1 ^ v2) << 1);
+    }
+};
+
+#endif //MARCHING_CUBES_POINT_CLOUD_CLASSIFICATION_HPP
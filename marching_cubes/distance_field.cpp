@@ -3,6 +3,8 @@
 //
 
 #include "distance_field.hpp"
+#include "distance_transform.hpp"
+#include "parallel.hpp"
 #include "../third_party/glm/include/glm/glm.hpp"
 #include "../render/labutils/vkutil.hpp" //TODO: add include folder to make includes nicer
 #include "../render/labutils/to_string.hpp"
@@ -10,6 +12,10 @@
 #include <cstring>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
 
 /* Find min/max extents of the model in 3D space. Returns BoundingBox */
 BoundingBox get_bounding_box(std::vector<glm::vec3> const& point_cloud) {
@@ -33,98 +39,370 @@ BoundingBox get_bounding_box(std::vector<glm::vec3> const& point_cloud) {
 }
 
 
-/* Creates regular grid with given resolution (1/resolution). The grid is described in terms of 3D space units, not grid units.
- * Returns a vector of grid positions. Populates edge vector as the indices of its two ends. */
-std::vector<glm::vec3> create_regular_grid(float const& grid_resolution, std::vector<uint32_t>& grid_edges, BoundingBox& model_bbox) {
-    std::cout << "Creating regular grid" << std::endl;
-    std::vector<glm::vec3> grid_positions;
-
+/* Number of grid boxes (cells) along each axis for the given resolution. The grid has grid_boxes + 2 vertices along each axis */
+glm::ivec3 get_grid_boxes(float const& grid_resolution, BoundingBox const& model_bbox) {
     float scale = 1.0f / grid_resolution;
 
     glm::vec3 extents = glm::abs(model_bbox.max - model_bbox.min);
 
-    glm::ivec3 grid_boxes = {
+    return glm::ivec3 {
             extents.x / scale,
             extents.y / scale,
             extents.z / scale,
     };
-    std::cout << "Grid dimensions: " << grid_boxes.x << " x " << grid_boxes.y << " x " << grid_boxes.z << std::endl;
-
-    auto point_grid_approx = (extents.x+1) * (extents.y+1) * (extents.z+1);
-    if(point_grid_approx > 1000000) {
-        std::cerr << "Grid is too big - please use a file with smaller dimensions. Grid approx. size (points): "<< point_grid_approx << std::endl;
-        exit(EXIT_FAILURE);
-    }
-
-
-    auto get_index = [grid_boxes](unsigned int i, unsigned int j, unsigned int k) -> unsigned int {
-        return i * (grid_boxes.y + 2) * (grid_boxes.z + 2) + j * (grid_boxes.z + 2) + k;
-    }; // note this will only work in a loop structured like the one below
+}
 
+/* Describes the regular grid with given resolution (1/resolution) over the bounding box. The grid is described in terms of 3D
+ * space units, not grid units. There are grid_boxes + 2 vertices along each axis. */
+GridDescriptor get_grid_descriptor(float const& grid_resolution, BoundingBox const& model_bbox) {
+    return GridDescriptor{
+        .origin = model_bbox.min,
+        .scale = 1.0f / grid_resolution,
+        .dims = get_grid_boxes(grid_resolution, model_bbox) + 2
+    };
+}
 
-    for (unsigned int i = 0; i <= grid_boxes.x + 1 ; i++) {
-//        std::cout << "i: " << i << std::endl;
-        for(unsigned int j = 0; j <= grid_boxes.y + 1; j++) {
-//            std::cout << "j: " << j << std::endl;
-            for(unsigned int k = 0; k <= grid_boxes.z + 1; k++) {
-                // Add point
-                grid_positions.emplace_back(
-                        model_bbox.min.x + (i * scale),
-                        model_bbox.min.y + (j * scale),
-                        model_bbox.min.z + (k * scale)
-                        );
+/* Creates regular grid with given resolution (1/resolution). Vertex positions are implicit (see GridDescriptor).
+ * Returns the grid descriptor. Populates edge vector as the indices of its two ends. The edges are drawn as a 32-bit index
+ * buffer, so grids with more vertices than a 32-bit index can address throw std::length_error instead of wrapping around. */
+GridDescriptor create_regular_grid(float const& grid_resolution, std::vector<uint32_t>& grid_edges, BoundingBox& model_bbox) {
+    std::cout << "Creating regular grid" << std::endl;
+    GridDescriptor grid = get_grid_descriptor(grid_resolution, model_bbox);
+    glm::ivec3 const& dims = grid.dims;
+    std::cout << "Grid dimensions: " << dims.x - 2 << " x " << dims.y - 2 << " x " << dims.z - 2 << std::endl;
+    if(grid.vertex_count() - 1 > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Grid has " + std::to_string(grid.vertex_count()) + " vertices, too many for 32-bit edge indices");
+    }
 
+    for (int i = 0; i < dims.x; i++) {
+        for(int j = 0; j < dims.y; j++) {
+            for(int k = 0; k < dims.z; k++) {
                 // Add edges
-                if (i < grid_boxes.x + 1) {
-                    grid_edges.emplace_back(get_index(i, j, k));
-                    grid_edges.emplace_back(get_index(i + 1, j, k));
+                if (i < dims.x - 1) {
+                    grid_edges.emplace_back(static_cast<uint32_t>(grid.get_index(i, j, k)));
+                    grid_edges.emplace_back(static_cast<uint32_t>(grid.get_index(i + 1, j, k)));
                 }
-                if (j < grid_boxes.y + 1) {
-                    grid_edges.emplace_back(get_index(i, j, k));
-                    grid_edges.emplace_back(get_index(i, j + 1, k));
+                if (j < dims.y - 1) {
+                    grid_edges.emplace_back(static_cast<uint32_t>(grid.get_index(i, j, k)));
+                    grid_edges.emplace_back(static_cast<uint32_t>(grid.get_index(i, j + 1, k)));
                 }
-                if (k < grid_boxes.z + 1) {
-                    grid_edges.emplace_back(get_index(i, j, k));
-                    grid_edges.emplace_back(get_index(i, j, k + 1));
+                if (k < dims.z - 1) {
+                    grid_edges.emplace_back(static_cast<uint32_t>(grid.get_index(i, j, k)));
+                    grid_edges.emplace_back(static_cast<uint32_t>(grid.get_index(i, j, k + 1)));
                 }
             }
         }
     }
+    return grid;
+}
+
+/* Returns a vector of grid positions, in the same order as the vertex indices */
+std::vector<glm::vec3> get_grid_positions(GridDescriptor const& grid) {
+    std::vector<glm::vec3> grid_positions;
+    grid_positions.reserve(grid.vertex_count());
+    for (int i = 0; i < grid.dims.x; i++) {
+        for(int j = 0; j < grid.dims.y; j++) {
+            for(int k = 0; k < grid.dims.z; k++) {
+                grid_positions.push_back(grid.position(i, j, k));
+            }
+        }
+    }
     return grid_positions;
 }
 
 
 /* For each grid vertex, find distance to nearest point cloud vertices (integer value).
+ * The grid is split into its i-slabs, which are evaluated in parallel. Each slab writes to its own range of the pre-sized
+ * output, so the result does not depend on the number of threads.
+ * Returns vector of scalar values at grid vertices */
+template<typename Scalar>
+std::vector<Scalar> calculate_distance_field(GridDescriptor const& grid, std::vector<glm::vec3> const& point_cloud_vertices,
+                                             unsigned int const& n_threads) {
+    std::cout << "Calculating distance field with " << grid.vertex_count() << " vertices" << std::endl;
+    std::vector<Scalar> grid_scalar_value(grid.vertex_count());
+
+    parallel_for_slabs(grid.dims.x, n_threads, [&](unsigned int slab) {
+        for(int j = 0; j < grid.dims.y; j++) {
+            for(int k = 0; k < grid.dims.z; k++) {
+                glm::vec3 grid_vertex = grid.position(slab, j, k);
+                float distance = std::numeric_limits<float>::max();
+                for(auto const& pcloud_vertex: point_cloud_vertices) {
+                    int d = glm::distance(grid_vertex, pcloud_vertex);
+                    distance = (d < distance) ? d : distance;
+                }
+                grid_scalar_value[grid.get_index(slab, j, k)] = saturate_scalar<Scalar>(distance);
+            }
+        }
+    });
+    return grid_scalar_value;
+}
+
+/* For each grid vertex, find distance to nearest point cloud vertex (integer value) with a nearest neighbour query on the KD-tree.
+ * Produces the same values as the brute force version above, also evaluated over i-slabs in parallel.
+ * The distance function is 1-Lipschitz, so the previous vertex's value plus the distance between both vertices bounds the
+ * search (+2 covers the truncation of both values to ints). The first vertex of a slab is searched unbounded.
+ * The bound uses the unsaturated distance, so narrow scalar types do not tighten it. */
+template<typename Scalar>
+std::vector<Scalar> calculate_distance_field(GridDescriptor const& grid, KDTree const& point_cloud_tree, unsigned int const& n_threads) {
+    std::cout << "Calculating distance field with " << grid.vertex_count() << " vertices (KD-tree)" << std::endl;
+    std::vector<Scalar> grid_scalar_value(grid.vertex_count());
+
+    parallel_for_slabs(grid.dims.x, n_threads, [&](unsigned int slab) {
+        int previous_value = std::numeric_limits<int>::max();
+        glm::vec3 previous_vertex{0.0f};
+        for(int j = 0; j < grid.dims.y; j++) {
+            for(int k = 0; k < grid.dims.z; k++) {
+                glm::vec3 grid_vertex = grid.position(slab, j, k);
+                int upper_bound = std::numeric_limits<int>::max();
+                if(previous_value != std::numeric_limits<int>::max()) {
+                    upper_bound = previous_value + 2 + (int)glm::distance(previous_vertex, grid_vertex);
+                }
+                previous_value = point_cloud_tree.nearest_distance(grid_vertex, upper_bound);
+                previous_vertex = grid_vertex;
+                grid_scalar_value[grid.get_index(slab, j, k)] = saturate_scalar<Scalar>(previous_value);
+            }
+        }
+    });
+    return grid_scalar_value;
+}
+
+/* Classification-first evaluation of the distance field. classify_grid_vertices only needs to know if a vertex is within the
+ * isovalue of some point, and query_case_table only reads scalar values at the ends of bipolar edges.
+ * First pass: fixed radius query (KDTree::any_within) for every vertex, which stops at the first close point (negative)
+ * or prunes the whole tree quickly far from the surface (positive).
+ * Second pass: exact nearest distance only for vertices with a 6-neighbour of the other class. Others are set to isovalue
+ * (negative) or isovalue + 1 (positive). Both passes run over i-slabs in parallel.
+ * Returns vector of scalar values at grid vertices */
+template<typename Scalar>
+std::vector<Scalar> calculate_band_distance_field(GridDescriptor const& grid, KDTree const& point_cloud_tree, int const& isovalue,
+                                                  unsigned int const& n_threads) {
+    std::cout << "Calculating distance field with " << grid.vertex_count() << " vertices (classification first)" << std::endl;
+    std::vector<Scalar> grid_scalar_value(grid.vertex_count());
+    std::vector<unsigned char> negative(grid.vertex_count());
+    glm::ivec3 const& dims = grid.dims;
+
+    parallel_for_slabs(dims.x, n_threads, [&](unsigned int slab) {
+        for(int j = 0; j < dims.y; j++) {
+            for(int k = 0; k < dims.z; k++) {
+                negative[grid.get_index(slab, j, k)] = point_cloud_tree.any_within(grid.position(slab, j, k), isovalue);
+            }
+        }
+    });
+
+    std::size_t const strides[3] = {(std::size_t)dims.y * dims.z, (std::size_t)dims.z, 1};
+    parallel_for_slabs(dims.x, n_threads, [&](unsigned int slab) {
+        for(int j = 0; j < dims.y; j++) {
+            for(int k = 0; k < dims.z; k++) {
+                std::size_t vertex = grid.get_index(slab, j, k);
+                glm::ivec3 const ijk{(int)slab, j, k};
+
+                //Find a 6-neighbour on the other side of the surface
+                int band_axis = -1;
+                for(int axis = 0; axis < 3 && band_axis == -1; axis++) {
+                    if((ijk[axis] > 0 && negative[vertex - strides[axis]] != negative[vertex]) ||
+                       (ijk[axis] < dims[axis] - 1 && negative[vertex + strides[axis]] != negative[vertex])) {
+                        band_axis = axis;
+                    }
+                }
+
+                if(band_axis == -1) {
+                    grid_scalar_value[vertex] = saturate_scalar<Scalar>(negative[vertex] ? isovalue : isovalue + 1);
+                } else if(negative[vertex]) {
+                    grid_scalar_value[vertex] = saturate_scalar<Scalar>(point_cloud_tree.nearest_distance(grid.position(ijk), isovalue + 1));
+                } else {
+                    //Lipschitz bound from the negative neighbour (one cell away), whose distance is at most the isovalue
+                    int upper_bound = isovalue + 2 + (int)std::ceil(grid.scale);
+                    grid_scalar_value[vertex] = saturate_scalar<Scalar>(point_cloud_tree.nearest_distance(grid.position(ijk), upper_bound));
+                }
+            }
+        }
+    });
+    return grid_scalar_value;
+}
+
+/* Coarse-to-fine evaluation of the distance field. The grid is split into blocks of COARSE_BLOCK_SIZE^3 cubes and exact distances
+ * are first only computed at the block corners (the coarse grid). Every vertex of a block is within half of the block diagonal (h)
+ * of one of its corners, so as the distance function is 1-Lipschitz, its distance is in [min corner - h, max corner + 1 + h)
+ * (+1 covers the truncation of the corner values to ints). Blocks where this is >= isovalue + 1 are all positive, blocks where
+ * it is < isovalue + 1 all negative, and the rest are refined.
+ * Vertices of refined blocks (including their faces) get exact distances, bounded by the previous vertex as in the KD-tree
+ * engine. The rest get isovalue + 1 (positive) or isovalue (negative). Both passes run over slabs in parallel.
  * Returns vector of scalar values at grid vertices */
-std::vector<int> calculate_distance_field(std::vector<glm::vec3> const& grid_vertices, std::vector<glm::vec3> const& point_cloud_vertices) {
-    std::cout << "Calculating distance field with " << grid_vertices.size() << " vertices" << std::endl;
-    std::vector<int> grid_scalar_value;
-
-    for(auto const& grid_vertex : grid_vertices) {
-        float distance = std::numeric_limits<float>::max();
-        for(auto const& pcloud_vertex: point_cloud_vertices) {
-            int d = glm::distance(grid_vertex, pcloud_vertex);
-            distance = (d < distance) ? d : distance;
+template<typename Scalar>
+std::vector<Scalar> calculate_coarse_to_fine_distance_field(GridDescriptor const& grid, KDTree const& point_cloud_tree,
+                                                            int const& isovalue, unsigned int const& n_threads) {
+    std::cout << "Calculating distance field with " << grid.vertex_count() << " vertices (coarse to fine)" << std::endl;
+    glm::ivec3 const& dims = grid.dims;
+    glm::ivec3 const n_blocks = (dims + COARSE_BLOCK_SIZE - 2) / COARSE_BLOCK_SIZE; // Blocks along each axis, the last ones may be cut
+    glm::ivec3 const coarse_dims = n_blocks + 1; // Coarse vertices along each axis
+    auto coarse_index = [&](glm::ivec3 const& coarse) {
+        return ((std::size_t)coarse.x * coarse_dims.y + coarse.y) * coarse_dims.z + coarse.z;
+    };
+    auto coarse_vertex = [&](glm::ivec3 const& coarse) { // Grid coordinates of a coarse vertex
+        return glm::min(coarse * COARSE_BLOCK_SIZE, dims - 1);
+    };
+
+    //Coarse grid
+    std::vector<int> coarse_values((std::size_t)coarse_dims.x * coarse_dims.y * coarse_dims.z);
+    parallel_for_slabs(coarse_dims.x, n_threads, [&](unsigned int slab) {
+        for(int j = 0; j < coarse_dims.y; j++) {
+            for(int k = 0; k < coarse_dims.z; k++) {
+                glm::ivec3 const coarse{(int)slab, j, k};
+                coarse_values[coarse_index(coarse)] =
+                        point_cloud_tree.nearest_distance(grid.position(coarse_vertex(coarse)), std::numeric_limits<int>::max());
+            }
+        }
+    });
+
+    //Block classification
+    enum : unsigned char { BLOCK_NEGATIVE, BLOCK_POSITIVE, BLOCK_REFINE };
+    std::vector<unsigned char> block_state((std::size_t)n_blocks.x * n_blocks.y * n_blocks.z);
+    auto block_index = [&](int bi, int bj, int bk) {
+        return ((std::size_t)bi * n_blocks.y + bj) * n_blocks.z + bk;
+    };
+    std::size_t n_refined = 0;
+    for(int bi = 0; bi < n_blocks.x; bi++) {
+        for(int bj = 0; bj < n_blocks.y; bj++) {
+            for(int bk = 0; bk < n_blocks.z; bk++) {
+                glm::ivec3 const block{bi, bj, bk};
+                int min_value = std::numeric_limits<int>::max();
+                int max_value = 0;
+                for(auto const& offset : {glm::ivec3{0, 0, 0}, glm::ivec3{0, 0, 1}, glm::ivec3{0, 1, 0}, glm::ivec3{0, 1, 1},
+                                          glm::ivec3{1, 0, 0}, glm::ivec3{1, 0, 1}, glm::ivec3{1, 1, 0}, glm::ivec3{1, 1, 1}}) {
+                    int value = coarse_values[coarse_index(block + offset)];
+                    min_value = std::min(min_value, value);
+                    max_value = std::max(max_value, value);
+                }
+                //Half diagonal, with a margin for the rounding of the float positions
+                glm::vec3 extent = glm::vec3(coarse_vertex(block + 1) - coarse_vertex(block));
+                float half_diagonal = 0.5f * grid.scale * (glm::length(extent) + 0.01f);
+
+                unsigned char& state = block_state[block_index(bi, bj, bk)];
+                if((float)min_value - half_diagonal >= (float)(isovalue + 1)) {
+                    state = BLOCK_POSITIVE;
+                } else if((float)max_value + half_diagonal <= (float)isovalue) {
+                    state = BLOCK_NEGATIVE;
+                } else {
+                    state = BLOCK_REFINE;
+                    n_refined++;
+                }
+            }
         }
-        grid_scalar_value.push_back(distance);
     }
+    std::cout << "Refining " << n_refined << " of " << block_state.size() << " blocks" << std::endl;
+
+    //Range of blocks each grid coordinate is in, along each axis. Coordinates on a block face are in two blocks
+    std::vector<int> first_block[3], last_block[3];
+    for(int axis = 0; axis < 3; axis++) {
+        first_block[axis].resize(dims[axis]);
+        last_block[axis].resize(dims[axis]);
+        for(int v = 0; v < dims[axis]; v++) {
+            last_block[axis][v] = std::min(v / COARSE_BLOCK_SIZE, n_blocks[axis] - 1);
+            first_block[axis][v] = (v > 0 && v % COARSE_BLOCK_SIZE == 0) ? v / COARSE_BLOCK_SIZE - 1 : last_block[axis][v];
+        }
+    }
+
+    //Fine grid
+    std::vector<Scalar> grid_scalar_value(grid.vertex_count());
+    parallel_for_slabs(dims.x, n_threads, [&](unsigned int slab) {
+        int const i = slab;
+        for(int j = 0; j < dims.y; j++) {
+            int previous_value = std::numeric_limits<int>::max();
+            glm::vec3 previous_vertex{0.0f};
+            for(int k = 0; k < dims.z; k++) {
+                bool refine = false;
+                for(int bi = first_block[0][i]; bi <= last_block[0][i] && !refine; bi++) {
+                    for(int bj = first_block[1][j]; bj <= last_block[1][j] && !refine; bj++) {
+                        for(int bk = first_block[2][k]; bk <= last_block[2][k] && !refine; bk++) {
+                            refine = block_state[block_index(bi, bj, bk)] == BLOCK_REFINE;
+                        }
+                    }
+                }
+
+                std::size_t vertex = grid.get_index(i, j, k);
+                if(!refine) {
+                    //Every block the vertex is in was proved to be on the same side of the surface
+                    bool positive = block_state[block_index(last_block[0][i], last_block[1][j], last_block[2][k])] == BLOCK_POSITIVE;
+                    grid_scalar_value[vertex] = saturate_scalar<Scalar>(positive ? isovalue + 1 : isovalue);
+                    previous_value = std::numeric_limits<int>::max();
+                    continue;
+                }
+
+                glm::vec3 grid_vertex = grid.position(i, j, k);
+                int upper_bound = std::numeric_limits<int>::max();
+                if(previous_value != std::numeric_limits<int>::max()) {
+                    upper_bound = previous_value + 2 + (int)glm::distance(previous_vertex, grid_vertex);
+                }
+                previous_value = point_cloud_tree.nearest_distance(grid_vertex, upper_bound);
+                previous_vertex = grid_vertex;
+                grid_scalar_value[vertex] = saturate_scalar<Scalar>(previous_value);
+            }
+        }
+    });
     return grid_scalar_value;
 }
 
+/* Dispatches to the distance field engine picked in the configuration. All engines return the scalar values laid out
+ * like the grid created by create_regular_grid */
+template<typename Scalar>
+std::vector<Scalar> evaluate_distance_field(DistanceFieldEngine engine, GridDescriptor const& grid,
+                                            std::vector<glm::vec3> const& point_cloud_vertices, KDTree const& point_cloud_tree,
+                                            int const& isovalue, int const& n_threads) {
+    unsigned int threads = resolve_thread_count(n_threads);
+    switch (engine) {
+        case DistanceFieldEngine::brute_force:
+            return calculate_distance_field<Scalar>(grid, point_cloud_vertices, threads);
+        case DistanceFieldEngine::distance_transform:
+            return calculate_distance_transform<Scalar>(point_cloud_vertices, grid, threads);
+        case DistanceFieldEngine::classify_first:
+            return calculate_band_distance_field<Scalar>(grid, point_cloud_tree, isovalue, threads);
+        case DistanceFieldEngine::coarse_to_fine:
+            return calculate_coarse_to_fine_distance_field<Scalar>(grid, point_cloud_tree, isovalue, threads);
+        case DistanceFieldEngine::kd_tree:
+        default:
+            return calculate_distance_field<Scalar>(grid, point_cloud_tree, threads);
+    }
+}
+
+/* Evaluates the distance field into the scalar type picked in the configuration. Narrow types cut the memory traffic of the
+ * field (and of everything that reads it) by 2x or 4x, but only give the same surface if the values around the isovalue fit */
+ScalarField evaluate_distance_field(ScalarFieldType type, DistanceFieldEngine engine, GridDescriptor const& grid,
+                                    std::vector<glm::vec3> const& point_cloud_vertices, KDTree const& point_cloud_tree,
+                                    int const& isovalue, int const& n_threads) {
+    auto evaluate = [&]<typename Scalar>() -> ScalarField {
+        if(!scalar_field_fits<Scalar>(isovalue, grid.scale)) {
+            std::cerr << "Warning: isovalue " << isovalue << " does not fit the scalar field type, distances will saturate" << std::endl;
+        }
+        return evaluate_distance_field<Scalar>(engine, grid, point_cloud_vertices, point_cloud_tree, isovalue, n_threads);
+    };
+    switch (type) {
+        case ScalarFieldType::uint8:
+            return evaluate.template operator()<std::uint8_t>();
+        case ScalarFieldType::uint16:
+            return evaluate.template operator()<std::uint16_t>();
+        case ScalarFieldType::int32:
+        default:
+            return evaluate.template operator()<int>();
+    }
+}
+
 /* Classifies grid vertices as negative and positive. Negative - 0 ; Positive - 1
  * In order to ensure manifoldness, 0.5 is added to the isovalue (which avoids the case of isovalue == grid scalar value),
- * since scalar values are ints. Returns a vector of positive/negative classification */
-std::vector<unsigned int> classify_grid_vertices(std::vector<int> const& grid_scalar_values, int const& isovalue) {
-    std::vector<unsigned int> grid_vertex_classification;
+ * since scalar values are ints. Each word of 64 vertices is built in a register and written once.
+ * Returns the bit-packed positive/negative classification */
+template<typename Scalar>
+VertexClassification classify_grid_vertices(std::vector<Scalar> const& grid_scalar_values, int const& isovalue) {
+    VertexClassification grid_vertex_classification(grid_scalar_values.size());
     float const isovalue_05 = isovalue + 0.5;
-    for(auto const& grid_value : grid_scalar_values) {
-//        assert(grid_value != isovalue_05); //This should never happen, but if it does, it will not produce a manifold surface.
-        if(grid_value >= isovalue_05) {
-            grid_vertex_classification.push_back(1); // Positive
-        }
-        if(grid_value < isovalue_05) {
-            grid_vertex_classification.push_back(0); // Negative
+    for(std::size_t word = 0; word < grid_vertex_classification.words.size(); word++) {
+        std::size_t first = word * 64;
+        std::size_t last = std::min(first + 64, grid_scalar_values.size());
+        std::uint64_t bits = 0;
+        for(std::size_t vertex = first; vertex < last; vertex++) {
+//            assert(grid_scalar_values[vertex] != isovalue_05); //This should never happen, but if it does, it will not produce a manifold surface.
+            bits |= std::uint64_t{grid_scalar_values[vertex] >= isovalue_05} << (vertex - first); // 1 - Positive, 0 - Negative
         }
+        grid_vertex_classification.words[word] = bits;
     }
     return grid_vertex_classification;
 }
@@ -133,103 +411,51 @@ std::vector<unsigned int> classify_grid_vertices(std::vector<int> const& grid_sc
  * -------------------------> 0 : negative - two endpoints of the edge are negative,
  * -------------------------> 1 : positive - two endpoints of the edge are positive,
  * -------------------------> 2 : bipolar - one endpoint is positive and the other negative.
- * Returns a vector of positive/negative/bipolar classification AND its color, represented in RGB */
-std::pair<std::vector<unsigned int>, std::vector<glm::vec3>> classify_grid_edges(std::vector<unsigned int> const& grid_scalar_values, BoundingBox const& model_bbox,
-                                                                                 float const& grid_resolution) {
-    glm::vec3 extents = glm::abs(model_bbox.max - model_bbox.min);
-    float scale = 1.0f / grid_resolution;
-
-    glm::ivec3 grid_boxes = {
-            extents.x / scale,
-            extents.y / scale,
-            extents.z / scale,
-    };
+ * Edges are classified in the same order create_regular_grid lists them.
+ * Returns the bit-packed positive/negative/bipolar classification */
+EdgeClassification classify_grid_edges(VertexClassification const& grid_vertex_classification, GridDescriptor const& grid) {
+    glm::ivec3 const& dims = grid.dims;
 
     std::cout << "Classifying grid edges" << std::endl;
-    std::vector<unsigned int> edge_values;
-    std::vector<glm::vec3> edge_colors;
-    edge_colors.resize(grid_scalar_values.size()*2);
-
-    auto get_index = [grid_boxes](unsigned int i, unsigned int j, unsigned int k) -> unsigned int {
-        return i * (grid_boxes.y + 2) * (grid_boxes.z + 2) + j * (grid_boxes.z + 2) + k;
-    }; // note this will only work in a loop structured like the one below
-
-    auto get_edge_value = [](unsigned int v1, unsigned int v2) -> unsigned int {
-        if (v1 == 1 && v2 == 1) {
-            return 1; // Positive edge
-        } else if (v1 == 0 && v2 == 0) {
-            return 0; // Negative edge
-        } else {
-            return 2; // Bipolar edge
-        }
-    };
-
-    auto get_edge_color = [](unsigned int value) -> glm::vec3 {
-        switch (value) {
-            case 0: //Negative
-                return glm::vec3{0.0f, 0.f, 0.f};
-                break;
-            case 1: //Positive
-                return glm::vec3{1.0f, 1.0f, 1.0f};
-                break;
-            case 2: //Bipolar
-                return glm::vec3{1.0f, 0.f, 1.0f};
-                break;
-        }
-    };
+    EdgeClassification edge_values;
+    edge_values.reserve(grid.vertex_count() * 3);
 
-    for (unsigned int i = 0; i <= grid_boxes.x + 1; i++) {
-        for (unsigned int j = 0; j <= grid_boxes.y + 1; j++) {
-            for (unsigned int k = 0; k <= grid_boxes.z + 1; k++) {
-
-                unsigned int v1, v2, edge_value;
-                std::size_t idx1, idx2;
-                glm::vec3 edge_color;
+    for (int i = 0; i < dims.x; i++) {
+        for (int j = 0; j < dims.y; j++) {
+            for (int k = 0; k < dims.z; k++) {
+                std::size_t idx = grid.get_index(i, j, k);
+                unsigned int v = grid_vertex_classification[idx];
 
                 // Check edge vertices' values
-                if (i < grid_boxes.x + 1) {
-                    idx1 = (get_index(i, j, k));
-                    idx2 = get_index(i + 1, j, k);
-                    v1 = grid_scalar_values[idx1];
-                    v2 = grid_scalar_values[idx2];
-
-                    edge_value = get_edge_value(v1, v2);
-                    edge_color = get_edge_color(edge_value);
-
-                    edge_colors[idx1] = edge_color;
-                    edge_colors[idx2] = edge_color;
-                    edge_values.push_back(edge_value);
+                if (i < dims.x - 1) {
+                    edge_values.push_back(EdgeClassification::get_edge_value(v, grid_vertex_classification[grid.get_index(i + 1, j, k)]));
                 }
-                if (j < grid_boxes.y + 1) {
-                    idx1 = (get_index(i, j, k));
-                    idx2 = get_index(i , j + 1, k);
-                    v1 = grid_scalar_values[idx1];
-                    v2 = grid_scalar_values[idx2];
-
-                    edge_value = get_edge_value(v1, v2);
-                    edge_color = get_edge_color(edge_value);
-
-                    edge_colors[idx1] = edge_color;
-                    edge_colors[idx2] = edge_color;
-                    edge_values.push_back(edge_value);
+                if (j < dims.y - 1) {
+                    edge_values.push_back(EdgeClassification::get_edge_value(v, grid_vertex_classification[grid.get_index(i, j + 1, k)]));
                 }
-                if (k < grid_boxes.z + 1) {
-                    idx1 = (get_index(i, j, k));
-                    idx2 = get_index(i , j , k + 1);
-                    v1 = grid_scalar_values[idx1];
-                    v2 = grid_scalar_values[idx2];
-
-                    edge_value = get_edge_value(v1, v2);
-                    edge_color = get_edge_color(edge_value);
-
-                    edge_colors[idx1] = edge_color;
-                    edge_colors[idx2] = edge_color;
-                    edge_values.push_back(edge_value);
+                if (k < dims.z - 1) {
+                    edge_values.push_back(EdgeClassification::get_edge_value(v, grid_vertex_classification[idx + 1]));
                 }
             }
         }
     }
-    return std::make_pair(edge_values, edge_colors);
+    return edge_values;
+}
+
+/* Colors for rendering the grid edges, represented in RGB: negative - black, positive - white, bipolar - magenta.
+ * The color is stored at both ends of each edge (later edges overwrite earlier ones). */
+std::vector<glm::vec3> get_edge_colors(EdgeClassification const& edge_values, std::vector<uint32_t> const& grid_edges,
+                                       std::size_t const& n_vertices) {
+    glm::vec3 const colors[3] = {glm::vec3{0.0f, 0.f, 0.f},   // Negative
+                                 glm::vec3{1.0f, 1.0f, 1.0f}, // Positive
+                                 glm::vec3{1.0f, 0.f, 1.0f}}; // Bipolar
+
+    std::vector<glm::vec3> edge_colors(n_vertices * 2);
+    for(std::size_t edge = 0; edge < edge_values.size(); edge++) {
+        edge_colors[grid_edges[2 * edge]] = colors[edge_values[edge]];
+        edge_colors[grid_edges[2 * edge + 1]] = colors[edge_values[edge]];
+    }
+    return edge_colors;
 }
 
 /* In order to ensure that the surface created actually encompasses the model, the bounding box needs to be
@@ -249,7 +475,8 @@ void BoundingBox::add_padding(const float& increment_factor) {
 }
 
 /* Returns a vector of the point values of the distance field, normalised and linearly inversely transformed */
-std::vector<int> apply_point_size_transfer_function(std::vector<int> const& distance_field) {
+template<typename Scalar>
+std::vector<int> apply_point_size_transfer_function(std::vector<Scalar> const& distance_field) {
     std::vector<int> distance_field_transfer;
     int min_val = *std::min_element(distance_field.begin(), distance_field.end());
     int max_val = *std::max_element(distance_field.begin(), distance_field.end());
@@ -270,3 +497,18 @@ std::vector<int> apply_point_size_transfer_function(std::vector<int> const& dist
 //float calculate_isovalue(PointCloud const& distance_field) {
 //
 //}
+
+#define INSTANTIATE_SCALAR_FIELD_FUNCTIONS(Scalar) \
+    template std::vector<Scalar> calculate_distance_field<Scalar>(GridDescriptor const&, std::vector<glm::vec3> const&, unsigned int const&); \
+    template std::vector<Scalar> calculate_distance_field<Scalar>(GridDescriptor const&, KDTree const&, unsigned int const&); \
+    template std::vector<Scalar> calculate_band_distance_field<Scalar>(GridDescriptor const&, KDTree const&, int const&, unsigned int const&); \
+    template std::vector<Scalar> calculate_coarse_to_fine_distance_field<Scalar>(GridDescriptor const&, KDTree const&, int const&, \
+                                                                                 unsigned int const&); \
+    template std::vector<Scalar> evaluate_distance_field<Scalar>(DistanceFieldEngine, GridDescriptor const&, std::vector<glm::vec3> const&, \
+                                                                 KDTree const&, int const&, int const&); \
+    template VertexClassification classify_grid_vertices<Scalar>(std::vector<Scalar> const&, int const&); \
+    template std::vector<int> apply_point_size_transfer_function<Scalar>(std::vector<Scalar> const&);
+
+INSTANTIATE_SCALAR_FIELD_FUNCTIONS(int)
+INSTANTIATE_SCALAR_FIELD_FUNCTIONS(std::uint16_t)
+INSTANTIATE_SCALAR_FIELD_FUNCTIONS(std::uint8_t)
@@ -11,6 +11,23 @@
 #include "../render/labutils/vulkan_context.hpp"
 #include "../render/labutils/allocator.hpp"
 #include "../render/labutils/vkbuffer.hpp"
+#include "kd_tree.hpp"
+#include "grid.hpp"
+#include "classification.hpp"
+#include "scalar_field.hpp"
+
+// Algorithm used to find the scalar value of each grid vertex. Picked with "distance_field_engine" in the .config file
+enum class DistanceFieldEngine {
+    brute_force,        // Compare every grid vertex against every point
+    kd_tree,            // Nearest neighbour query on a KD-tree over the point cloud
+    distance_transform, // Rasterise the points into the grid and run a euclidean distance transform. Not exact: points are
+                        // snapped to grid vertices, so values can be off by up to ceil(grid.scale * sqrt(3) / 2) and the
+                        // extracted surface differs (see distance_transform.hpp)
+    classify_first,     // Fixed radius classification on the KD-tree, exact distances only next to the surface
+    coarse_to_fine      // KD-tree distances on a coarse grid, only blocks which may contain the surface are refined
+};
+
+constexpr int COARSE_BLOCK_SIZE = 8; // Grid cubes along each axis of a block of the coarse_to_fine engine
 
 struct BoundingBox {
     glm::vec3 min;
@@ -23,22 +40,71 @@ struct BoundingBox {
 //Gets min/max coordinates representing point cloud bounding box.
 BoundingBox get_bounding_box(std::vector<glm::vec3> const& point_cloud);
 
-// Create regular grid in the space of the point cloud. Returns vector with 3d points of grid
-std::vector<glm::vec3> create_regular_grid(float const& grid_resolution, std::vector<uint32_t>& , BoundingBox&);
+// Number of grid boxes along each axis. Note the grid has grid_boxes + 2 vertices along each axis
+glm::ivec3 get_grid_boxes(float const& grid_resolution, BoundingBox const& model_bbox);
+
+// Grid covering the bounding box with the given resolution. Positions are computed from the indices, not stored
+GridDescriptor get_grid_descriptor(float const& grid_resolution, BoundingBox const& model_bbox);
+
+// Create regular grid in the space of the point cloud. Returns the grid descriptor and populates the grid edges.
+// Throws std::length_error if the grid has too many vertices for 32-bit edge indices
+GridDescriptor create_regular_grid(float const& grid_resolution, std::vector<uint32_t>& , BoundingBox&);
+
+// Positions of every grid vertex, in index order. Only needed for rendering the grid
+std::vector<glm::vec3> get_grid_positions(GridDescriptor const& grid);
+
+// Find scalar value for each point in the grid, evaluating its i-slabs on n_threads threads. Returns vector with these values.
+// The scalar field functions are instantiated for int, std::uint16_t and std::uint8_t storage (see scalar_field.hpp)
+template<typename Scalar>
+std::vector<Scalar> calculate_distance_field(GridDescriptor const& grid, std::vector<glm::vec3> const& point_cloud_vertices,
+                                             unsigned int const& n_threads);
 
-// Find scalar value for each point in the grid. Returns vector with these values
-std::vector<int> calculate_distance_field(std::vector<glm::vec3> const& grid_vertices, std::vector<glm::vec3> const& point_cloud_vertices);
+// Same as above, but queries a KD-tree built over the point cloud instead of comparing against every point.
+template<typename Scalar>
+std::vector<Scalar> calculate_distance_field(GridDescriptor const& grid, KDTree const& point_cloud_tree, unsigned int const& n_threads);
 
-// Classifies vertices as positive, negative. Returns vector with false = negative, true = positive
+// Classifies every grid vertex against the isovalue first and only computes exact distances for vertices with a 6-neighbour
+// on the other side of the surface. The rest get isovalue (negative) or isovalue + 1 (positive), which classify the same way.
+// Returns vector with these values; the surface extracted from them is the same as from the full distance field
+template<typename Scalar>
+std::vector<Scalar> calculate_band_distance_field(GridDescriptor const& grid, KDTree const& point_cloud_tree, int const& isovalue,
+                                                  unsigned int const& n_threads);
+
+// Evaluates the distance field on a coarse grid (every COARSE_BLOCK_SIZE-th vertex) first. Blocks between coarse vertices that
+// the Lipschitz bound proves to be all positive or all negative get isovalue + 1 or isovalue, like calculate_band_distance_field.
+// The others are refined with exact distances, so the extracted surface is the same as from the full distance field
+template<typename Scalar>
+std::vector<Scalar> calculate_coarse_to_fine_distance_field(GridDescriptor const& grid, KDTree const& point_cloud_tree,
+                                                            int const& isovalue, unsigned int const& n_threads);
+
+// Evaluates the distance field of the grid with the given engine. n_threads = 0 uses all hardware threads.
+// The isovalue is only used by DistanceFieldEngine::classify_first and coarse_to_fine. Returns vector with the scalar values
+template<typename Scalar>
+std::vector<Scalar> evaluate_distance_field(DistanceFieldEngine engine, GridDescriptor const& grid,
+                                            std::vector<glm::vec3> const& point_cloud_vertices, KDTree const& point_cloud_tree,
+                                            int const& isovalue, int const& n_threads);
+
+// Same as above, storing the scalar values with the width picked at runtime
+ScalarField evaluate_distance_field(ScalarFieldType type, DistanceFieldEngine engine, GridDescriptor const& grid,
+                                    std::vector<glm::vec3> const& point_cloud_vertices, KDTree const& point_cloud_tree,
+                                    int const& isovalue, int const& n_threads);
+
+// Classifies vertices as positive, negative. Returns bit-packed classification with 0 = negative, 1 = positive
 // If the isovalue picked coincides with a scalar value of the distance field, the user will be asked to input another value to ensure manifoldness.
 // Generally, the isovalue will be an integer + 0.5 to ensure this condition
-std::vector<unsigned int> classify_grid_vertices(std::vector<int> const& grid_scalar_values, int const& isovalue);
+template<typename Scalar>
+VertexClassification classify_grid_vertices(std::vector<Scalar> const& grid_scalar_values, int const& isovalue);
 
-//
-std::pair<std::vector<unsigned int>, std::vector<glm::vec3>> classify_grid_edges(std::vector<unsigned int> const& grid_vertex_classification,  BoundingBox const& model_bbox,
-                                                                                 float const& grid_resolution);
+// Classifies edges as negative, positive or bipolar (2 bits each), in the order of the edges created by create_regular_grid
+EdgeClassification classify_grid_edges(VertexClassification const& grid_vertex_classification, GridDescriptor const& grid);
+
+// Per vertex colors to render the classified grid edges with
+std::vector<glm::vec3> get_edge_colors(EdgeClassification const& edge_values, std::vector<uint32_t> const& grid_edges,
+                                       std::size_t const& n_vertices);
 
-std::vector<int> apply_point_size_transfer_function(std::vector<int> const&);
+// Maps scalar values to point sizes (1 to 5) for rendering
+template<typename Scalar>
+std::vector<int> apply_point_size_transfer_function(std::vector<Scalar> const&);
 
 //float calculate_isovalue(PointCloud const& distance_field);
 
@@ -0,0 +1,22 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_DISTANCE_TRANSFORM_HPP
+#define MARCHING_CUBES_POINT_CLOUD_DISTANCE_TRANSFORM_HPP
+
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "distance_field.hpp"
+
+// Find scalar value for each point in the regular grid by rasterising the point cloud into the grid and running an exact
+// euclidean distance transform. Cost is linear in the number of grid vertices, independent of the number of points.
+// Points are snapped to their closest grid vertex, so values can differ from calculate_distance_field by up to
+// ceil(grid.scale * sqrt(3) / 2) (1 for grid scales up to about 1.15).
+// Each pass runs on n_threads threads. Returns vector with these values, laid out like the grid created by create_regular_grid
+template<typename Scalar>
+std::vector<Scalar> calculate_distance_transform(std::vector<glm::vec3> const& point_cloud_vertices, GridDescriptor const& grid,
+                                                 unsigned int const& n_threads);
+
+#endif //MARCHING_CUBES_POINT_CLOUD_DISTANCE_TRANSFORM_HPP
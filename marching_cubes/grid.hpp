@@ -0,0 +1,49 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_GRID_HPP
+#define MARCHING_CUBES_POINT_CLOUD_GRID_HPP
+
+#include <cstddef>
+#include <glm/vec3.hpp>
+
+/* Implicit regular grid. Vertex positions are not stored, they are computed from the vertex's grid coordinates (ijk).
+ * Vertices are laid out with k varying fastest, then j, then i (i-slabs are contiguous). */
+struct GridDescriptor {
+    glm::vec3 origin; // Position of vertex (0, 0, 0), ie. the min corner of the (padded) bounding box
+    float scale;      // Distance between two neighbouring vertices, 1 / grid resolution
+    glm::ivec3 dims;  // Number of vertices along each axis. Note there are dims - 1 grid boxes (cubes) along each axis
+
+    std::size_t vertex_count() const {
+        return (std::size_t)dims.x * dims.y * dims.z;
+    }
+
+    std::size_t get_index(int i, int j, int k) const {
+        return ((std::size_t)i * dims.y + j) * dims.z + k;
+    }
+
+    std::size_t get_index(glm::ivec3 const& ijk) const {
+        return get_index(ijk.x, ijk.y, ijk.z);
+    }
+
+    glm::ivec3 get_ijk(std::size_t index) const {
+        int k = index % dims.z;
+        index /= dims.z;
+        return glm::ivec3{(int)(index / dims.y), (int)(index % dims.y), k};
+    }
+
+    glm::vec3 position(int i, int j, int k) const {
+        return glm::vec3{origin.x + (i * scale), origin.y + (j * scale), origin.z + (k * scale)};
+    }
+
+    glm::vec3 position(glm::ivec3 const& ijk) const {
+        return position(ijk.x, ijk.y, ijk.z);
+    }
+
+    glm::vec3 position(std::size_t index) const {
+        return position(get_ijk(index));
+    }
+};
+
+#endif //MARCHING_CUBES_POINT_CLOUD_GRID_HPP
@@ -0,0 +1,156 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "incremental_distance_field.hpp"
+#include "parallel.hpp"
+#include "../third_party/glm/include/glm/glm.hpp"
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <tuple>
+
+namespace {
+    // Calls visit(vertex index, vertex position) for every grid vertex within max_distance of the point (plus one cell of
+    // margin). The range along k is cut to the sphere for each row
+    template<typename Visit>
+    void for_each_vertex_near(IncrementalDistanceField const& field, glm::vec3 const& point, Visit&& visit) {
+        GridDescriptor const& grid = field.grid;
+        float radius = field.max_distance / grid.scale + 1.0f; // In grid units
+        glm::vec3 grid_point = (point - grid.origin) / grid.scale;
+        glm::ivec3 min_vertex = glm::clamp(glm::ivec3(glm::floor(grid_point - radius)), glm::ivec3(0), grid.dims - 1);
+        glm::ivec3 max_vertex = glm::clamp(glm::ivec3(glm::ceil(grid_point + radius)), glm::ivec3(0), grid.dims - 1);
+
+        for(int i = min_vertex.x; i <= max_vertex.x; i++) {
+            float di = i - grid_point.x;
+            for(int j = min_vertex.y; j <= max_vertex.y; j++) {
+                float dj = j - grid_point.y;
+                float remaining = radius * radius - di * di - dj * dj;
+                if(remaining < 0.0f) continue;
+                float half_row = std::sqrt(remaining);
+                int k_begin = std::max(min_vertex.z, (int)std::floor(grid_point.z - half_row));
+                int k_end = std::min(max_vertex.z, (int)std::ceil(grid_point.z + half_row));
+                for(int k = k_begin; k <= k_end; k++) {
+                    visit(grid.get_index(i, j, k), grid.position(i, j, k));
+                }
+            }
+        }
+    }
+
+    bool position_less(glm::vec3 const& a, glm::vec3 const& b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    }
+
+    // Sorts the changed vertices and finds the cubes they are a corner of
+    DistanceFieldUpdate finish_update(GridDescriptor const& grid, std::vector<std::size_t>&& changed_vertices) {
+        DistanceFieldUpdate update;
+        update.changed_vertices = std::move(changed_vertices);
+        std::sort(update.changed_vertices.begin(), update.changed_vertices.end());
+        update.changed_vertices.erase(std::unique(update.changed_vertices.begin(), update.changed_vertices.end()),
+                                      update.changed_vertices.end());
+
+        update.dirty_cells.reserve(update.changed_vertices.size() * 8);
+        for(std::size_t vertex : update.changed_vertices) {
+            glm::ivec3 ijk = grid.get_ijk(vertex);
+            for(int n = 0; n < 8; n++) {
+                glm::ivec3 cube = ijk - glm::ivec3{(n >> 2) & 1, (n >> 1) & 1, n & 1};
+                if(glm::all(glm::greaterThanEqual(cube, glm::ivec3(0))) && glm::all(glm::lessThan(cube, grid.dims - 1))) {
+                    update.dirty_cells.push_back(grid.get_index(cube));
+                }
+            }
+        }
+        std::sort(update.dirty_cells.begin(), update.dirty_cells.end());
+        update.dirty_cells.erase(std::unique(update.dirty_cells.begin(), update.dirty_cells.end()), update.dirty_cells.end());
+        return update;
+    }
+}
+
+/* Same integer distances as the KD-tree engine, clamped to max_distance. The clamp bounds every search, so vertices far
+ * from the point cloud are cheap. Evaluated over i-slabs in parallel */
+IncrementalDistanceField create_incremental_distance_field(GridDescriptor const& grid, std::vector<glm::vec3> const& point_cloud_vertices,
+                                                           int const& isovalue, unsigned int const& n_threads) {
+    IncrementalDistanceField field;
+    field.grid = grid;
+    field.isovalue = isovalue;
+    field.max_distance = isovalue + 2 + (int)std::ceil(grid.scale);
+    field.points = point_cloud_vertices;
+    field.tree = KDTree(field.points);
+    field.scalar_values.resize(grid.vertex_count());
+
+    std::cout << "Calculating distance field with " << grid.vertex_count() << " vertices (incremental)" << std::endl;
+    parallel_for_slabs(grid.dims.x, n_threads, [&](unsigned int slab) {
+        for(int j = 0; j < grid.dims.y; j++) {
+            for(int k = 0; k < grid.dims.z; k++) {
+                field.scalar_values[grid.get_index(slab, j, k)] =
+                        field.tree.nearest_distance(grid.position(slab, j, k), field.max_distance);
+            }
+        }
+    });
+    return field;
+}
+
+/* A new point can only lower distances, and the new distance of a vertex is the min of its old one and the distance to the
+ * new point (truncation to ints is monotonic). So every new point is splatted into the vertices around it, and no search is
+ * needed. The KD-tree is only rebuilt when points are removed. */
+DistanceFieldUpdate insert_points(IncrementalDistanceField& field, std::vector<glm::vec3> const& new_points) {
+    std::vector<std::size_t> changed_vertices;
+    for(auto const& point : new_points) {
+        for_each_vertex_near(field, point, [&](std::size_t vertex, glm::vec3 const& grid_vertex) {
+            int d = glm::distance(grid_vertex, point);
+            if(d < field.scalar_values[vertex]) {
+                field.scalar_values[vertex] = d;
+                changed_vertices.push_back(vertex);
+            }
+        });
+    }
+    field.points.insert(field.points.end(), new_points.begin(), new_points.end());
+    return finish_update(field.grid, std::move(changed_vertices));
+}
+
+/* Removing a point can only raise the distance of the vertices it was the nearest point of, ie. the vertices within
+ * max_distance whose distance to it is their scalar value. Only those are searched again, in the rebuilt KD-tree. */
+DistanceFieldUpdate remove_points(IncrementalDistanceField& field, std::vector<glm::vec3> const& removed_points,
+                                  unsigned int const& n_threads) {
+    std::vector<glm::vec3> sorted_removed = removed_points;
+    std::sort(sorted_removed.begin(), sorted_removed.end(), position_less);
+    std::size_t n_points = field.points.size();
+    std::erase_if(field.points, [&](glm::vec3 const& point) {
+        return std::binary_search(sorted_removed.begin(), sorted_removed.end(), point, position_less);
+    });
+    if(field.points.size() == n_points) return {};
+
+    std::vector<std::size_t> candidates;
+    for(auto const& point : sorted_removed) {
+        for_each_vertex_near(field, point, [&](std::size_t vertex, glm::vec3 const& grid_vertex) {
+            int value = field.scalar_values[vertex];
+            if(value < field.max_distance && (int)glm::distance(grid_vertex, point) <= value) {
+                candidates.push_back(vertex);
+            }
+        });
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    field.tree = KDTree(field.points);
+
+    //Candidates are split in contiguous chunks, each chunk writes to its own range of new_values
+    std::vector<int> new_values(candidates.size());
+    unsigned int const n_chunks = std::max(1u, std::min<unsigned int>(n_threads * 4, candidates.size()));
+    parallel_for_slabs(n_chunks, n_threads, [&](unsigned int chunk) {
+        std::size_t begin = candidates.size() * chunk / n_chunks;
+        std::size_t end = candidates.size() * (chunk + 1) / n_chunks;
+        for(std::size_t c = begin; c < end; c++) {
+            new_values[c] = field.tree.nearest_distance(field.grid.position(candidates[c]), field.max_distance);
+        }
+    });
+
+    std::vector<std::size_t> changed_vertices;
+    for(std::size_t c = 0; c < candidates.size(); c++) {
+        if(new_values[c] != field.scalar_values[candidates[c]]) {
+            field.scalar_values[candidates[c]] = new_values[c];
+            changed_vertices.push_back(candidates[c]);
+        }
+    }
+    return finish_update(field.grid, std::move(changed_vertices));
+}
@@ -0,0 +1,45 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_INCREMENTAL_DISTANCE_FIELD_HPP
+#define MARCHING_CUBES_POINT_CLOUD_INCREMENTAL_DISTANCE_FIELD_HPP
+
+#include <vector>
+#include <cstddef>
+#include <glm/vec3.hpp>
+
+#include "distance_field.hpp"
+#include "kd_tree.hpp"
+
+/* Distance field of a point cloud that changes over time (eg. scans appended to a live point cloud).
+ * Distances are clamped to max_distance, like the background value of the sparse grid, so a point only affects the vertices
+ * within max_distance of it. Everything further is positive, so the surface is the same as from the full distance field. */
+struct IncrementalDistanceField {
+    GridDescriptor grid;
+    int isovalue;
+    int max_distance; // isovalue + 2 + one cell. Scalar values are clamped to this value
+    std::vector<glm::vec3> points; // Current point cloud
+    KDTree tree; // Over points. Only needed to remove points, so it is only rebuilt then
+    std::vector<int> scalar_values; // Laid out like the grid (see GridDescriptor)
+};
+
+// What changed in an update, so later stages only need to recompute these regions
+struct DistanceFieldUpdate {
+    std::vector<std::size_t> changed_vertices; // Grid indices of the vertices whose scalar value changed, sorted
+    std::vector<std::size_t> dirty_cells; // Grid indices of the first vertex (min corner) of the cubes touching a changed vertex, sorted
+};
+
+// Evaluates the clamped distance field of the point cloud over the grid, on n_threads threads
+IncrementalDistanceField create_incremental_distance_field(GridDescriptor const& grid, std::vector<glm::vec3> const& point_cloud_vertices,
+                                                           int const& isovalue, unsigned int const& n_threads);
+
+// Adds points to the point cloud. Only the vertices within max_distance of a new point are visited
+DistanceFieldUpdate insert_points(IncrementalDistanceField& field, std::vector<glm::vec3> const& new_points);
+
+// Removes the points with these exact positions from the point cloud. Only the vertices whose nearest point was removed
+// are evaluated again, on n_threads threads
+DistanceFieldUpdate remove_points(IncrementalDistanceField& field, std::vector<glm::vec3> const& removed_points,
+                                  unsigned int const& n_threads);
+
+#endif //MARCHING_CUBES_POINT_CLOUD_INCREMENTAL_DISTANCE_FIELD_HPP
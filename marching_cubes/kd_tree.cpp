@@ -0,0 +1,137 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "kd_tree.hpp"
+#include "../third_party/glm/include/glm/glm.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <cmath>
+
+/* Builds the tree once for the given point cloud. The points are copied so the tree can reorder them */
+KDTree::KDTree(std::vector<glm::vec3> const& point_cloud) : points(point_cloud) {
+    std::cout << "Building KD-tree with " << points.size() << " points" << std::endl;
+    if(points.empty()) return;
+    nodes.reserve(2 * (points.size() / KD_TREE_LEAF_SIZE + 1));
+    build(0, points.size());
+}
+
+/* Recursively splits [begin, end) at the median of its longest axis. Returns index of the created node */
+int KDTree::build(unsigned int begin, unsigned int end) {
+    glm::vec3 min = points[begin];
+    glm::vec3 max = points[begin];
+    for(unsigned int p = begin + 1; p < end; p++) {
+        min = glm::min(min, points[p]);
+        max = glm::max(max, points[p]);
+    }
+
+    int node_idx = nodes.size();
+    nodes.push_back(Node{min, max, 0.0f, 0, begin, end});
+
+    if(end - begin <= KD_TREE_LEAF_SIZE) {
+        return node_idx; // Leaf
+    }
+
+    //Split along the axis with the largest extent
+    glm::vec3 extents = max - min;
+    unsigned int axis = 0;
+    if(extents.y > extents[axis]) axis = 1;
+    if(extents.z > extents[axis]) axis = 2;
+
+    unsigned int mid = begin + (end - begin) / 2;
+    std::nth_element(points.begin() + begin, points.begin() + mid, points.begin() + end,
+                     [axis](glm::vec3 const& a, glm::vec3 const& b) { return a[axis] < b[axis]; });
+
+    nodes[node_idx].split = points[mid][axis];
+    nodes[node_idx].axis = axis;
+
+    int left = build(begin, mid);
+    int right = build(mid, end);
+    nodes[node_idx].left = left;
+    nodes[node_idx].right = right;
+    return node_idx;
+}
+
+/* Lower bound of the integer distance from the query to any point inside the node's bounding box.
+ * Float rounding is monotonic, so the distance computed by glm::distance to a point in the box is never smaller than the
+ * distance to the box computed the same way. The small factor keeps the bound safe against differently ordered/fused
+ * float operations */
+int KDTree::distance_to_node(glm::vec3 const& query, Node const& node) const {
+    glm::vec3 delta = glm::max(node.min - query, glm::vec3(0.0f));
+    delta = glm::max(delta, query - node.max);
+    return std::sqrt(glm::dot(delta, delta)) * (1.0f - 1e-5f);
+}
+
+/* Finds the integer distance to the closest point. Distances are computed exactly like the brute force search
+ * (glm::distance truncated to an int), so the result is bit-identical.
+ * Nodes are skipped if the distance to their bounding box is not smaller than the best distance found so far. */
+int KDTree::nearest_distance(glm::vec3 const& query, int upper_bound) const {
+    int best = upper_bound;
+    if(nodes.empty()) return best;
+
+    struct StackEntry {
+        int node;
+        int bound; // Lower bound of the distance to any point in the node
+    };
+    StackEntry stack[64]; // Tree depth is log2(n / leaf size), 64 is never reached
+    unsigned int stack_size = 0;
+    stack[stack_size++] = {0, distance_to_node(query, nodes[0])};
+
+    while(stack_size > 0) {
+        StackEntry entry = stack[--stack_size];
+        if(entry.bound >= best) continue;
+
+        int node_idx = entry.node;
+        //Walk down to the leaf on the query's side, saving the far children for later
+        while(nodes[node_idx].left != -1) {
+            Node const& node = nodes[node_idx];
+            bool go_left = query[node.axis] < node.split;
+            int near = go_left ? node.left : node.right;
+            int far = go_left ? node.right : node.left;
+            int far_bound = distance_to_node(query, nodes[far]);
+            if(far_bound < best) {
+                stack[stack_size++] = {far, far_bound};
+            }
+            node_idx = near;
+        }
+
+        Node const& leaf = nodes[node_idx];
+        for(unsigned int p = leaf.begin; p < leaf.end; p++) {
+            int d = glm::distance(query, points[p]);
+            best = (d < best) ? d : best;
+        }
+        if(best == 0) break; // Can not get any closer
+    }
+    return best;
+}
+
+/* Same traversal as nearest_distance, but nodes are only visited if their bounding box is within max_distance of the query,
+ * and the search returns as soon as one point is close enough. Uses the same integer distances, so it agrees exactly with
+ * nearest_distance(query) <= max_distance. */
+bool KDTree::any_within(glm::vec3 const& query, int max_distance) const {
+    if(nodes.empty()) return false;
+
+    int stack[64];
+    unsigned int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while(stack_size > 0) {
+        Node const& node = nodes[stack[--stack_size]];
+        if(distance_to_node(query, node) > max_distance) continue;
+
+        if(node.left == -1) {
+            for(unsigned int p = node.begin; p < node.end; p++) {
+                int d = glm::distance(query, points[p]);
+                if(d <= max_distance) return true;
+            }
+            continue;
+        }
+        //Push far child first so the near child is visited first
+        bool go_left = query[node.axis] < node.split;
+        stack[stack_size++] = go_left ? node.right : node.left;
+        stack[stack_size++] = go_left ? node.left : node.right;
+    }
+    return false;
+}
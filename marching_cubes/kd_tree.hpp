@@ -0,0 +1,46 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_KD_TREE_HPP
+#define MARCHING_CUBES_POINT_CLOUD_KD_TREE_HPP
+
+#include <vector>
+#include <limits>
+#include <glm/vec3.hpp>
+
+constexpr unsigned int KD_TREE_LEAF_SIZE = 8; // Max number of points stored in a leaf
+
+/* Static (build once, query many times) KD-tree over the point cloud positions.
+ * Used to find the nearest point cloud vertex to each grid vertex without comparing against every point. */
+struct KDTree {
+    struct Node {
+        glm::vec3 min, max;     // Bounding box of the points in the node
+        float split;            // Splitting coordinate along axis. Left child <= split, right child >= split
+        unsigned int axis;      // 0 - x, 1 - y, 2 - z. Leaves have no axis
+        unsigned int begin, end; // Range in points covered by this node
+        int left = -1, right = -1; // Children. -1 if the node is a leaf
+    };
+
+    std::vector<glm::vec3> points; // Copy of the point cloud, reordered so every node covers a contiguous range
+    std::vector<Node> nodes; // nodes[0] is the root
+
+    KDTree() = default;
+    explicit KDTree(std::vector<glm::vec3> const& point_cloud);
+
+    bool empty() const { return points.empty(); }
+
+    // Integer distance to the nearest point, identical to the value of the brute force search.
+    // upper_bound must not be smaller than the answer; a tight bound lets the search skip more nodes.
+    int nearest_distance(glm::vec3 const& query, int upper_bound = std::numeric_limits<int>::max()) const;
+
+    // Fixed radius query: true if the integer distance to some point is <= max_distance, i.e. nearest_distance(query) <= max_distance.
+    // Stops at the first point found, so it is much cheaper than nearest_distance when only the answer's side is needed.
+    bool any_within(glm::vec3 const& query, int max_distance) const;
+
+private:
+    int build(unsigned int begin, unsigned int end);
+    int distance_to_node(glm::vec3 const& query, Node const& node) const;
+};
+
+#endif //MARCHING_CUBES_POINT_CLOUD_KD_TREE_HPP
@@ -24,7 +24,7 @@ int vertPos[8][3] = {
 /* each entry is an edge of the cube, and consists of the two vertices at the end of the edge */
 /* which will be used for interpolation */
 
-int edgeTable[12][2] = {
+extern constexpr int edgeTable[12][2] = {
         { 0, 2 },
         { 2, 3 },
         { 1, 3 },
@@ -54,7 +54,7 @@ int edgeTable[12][2] = {
  *
  */
 
-int triangleTable[256][17] = {
+extern constexpr int triangleTable[256][17] = {
         { 0,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  0 },
         { 1,  0,  3,  8,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  1 },
         { 1,  2,  11,  3,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  1 },
@@ -573,4 +573,30 @@ int triangleTableBroken[256][16] = {
 
 };
 
+namespace {
+    /* Derives caseTable from triangleTable. Built by the compiler: constexpr forces the whole table to be computed at compile time,
+     * so it is constant data like the tables above. 32 bytes per case, 8KB in total */
+    constexpr std::array<CaseTableEntry, 256> make_case_table() {
+        std::array<CaseTableEntry, 256> table{};
+        for(int case_index = 0; case_index < 256; case_index++) {
+            int const* row = triangleTable[case_index];
+            CaseTableEntry& entry = table[case_index];
+            entry.n_triangles = row[0];
+            for(int n = 0; n < row[0] * 3; n++) {
+                int edge = row[n + 1];
+                if((entry.edge_mask & (1u << edge)) == 0) {
+                    entry.edge_mask |= 1u << edge;
+                    entry.edges[entry.n_edges++] = edge;
+                }
+                int position = 0;
+                while(entry.edges[position] != edge) position++;
+                entry.triangles[n] = position;
+            }
+        }
+        return table;
+    }
+}
 
+extern constexpr std::array<CaseTableEntry, 256> caseTable = make_case_table();
+static_assert(sizeof(CaseTableEntry) == 32);
+static_assert(caseTable[1].edge_mask == ((1u << 0) | (1u << 3) | (1u << 8)) && caseTable[255].n_triangles == 0);
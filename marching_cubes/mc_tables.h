@@ -1,9 +1,25 @@
 #ifndef _LOOKUPTABLES_
 #define _LOOKUPTABLES_
 
+#include <cstdint>
+#include <array>
+
 extern int vertPos[8][3];
-extern int edgeTable[12][2];
-extern int triangleTable[256][17];
+extern int const edgeTable[12][2];
+extern int const triangleTable[256][17];
 extern int triangleTableBroken[256][16];
 
-#endif
\ No newline at end of file
+/* Compact form of a row of triangleTable, generated from it at compile time (see mc_tables.cpp).
+ * Every intersected edge is listed once, in the order the triangles first use it, so its vertex is interpolated once per cube.
+ * Triangles refer to the edges by their position in that list. */
+struct CaseTableEntry {
+    std::uint16_t edge_mask;     // Bit e is set if cube edge e is intersected
+    std::uint8_t n_edges;        // Number of intersected edges (0-12)
+    std::uint8_t n_triangles;    // Number of triangles (0-5)
+    std::uint8_t edges[12];      // Intersected cube edges (see edgeTable)
+    std::uint8_t triangles[15];  // 3 positions in edges per triangle
+};
+
+extern std::array<CaseTableEntry, 256> const caseTable;
+
+#endif
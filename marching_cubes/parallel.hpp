@@ -0,0 +1,159 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_PARALLEL_HPP
+#define MARCHING_CUBES_POINT_CLOUD_PARALLEL_HPP
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+/* Number of worker threads to use. 0 (or negative) picks one thread per hardware thread */
+inline unsigned int resolve_thread_count(int const& requested_threads) {
+    if(requested_threads > 0) return requested_threads;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/* Process wide pool of worker threads shared by every parallel_for_slabs call. The threads are started the first time a call
+ * needs them and are kept alive (sleeping on a condition variable) until the program exits, so the many short parallel passes
+ * of a reconstruction do not pay for starting and joining threads every time. The pool only grows, up to the largest
+ * n_threads requested so far.
+ * One job runs at a time. A call made while the pool is busy (from another thread, or from inside a task) runs on its calling
+ * thread alone instead of waiting, so nested calls cannot deadlock. */
+class WorkerPool {
+public:
+    static WorkerPool& get() {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    /* Runs job on n_helpers pool threads and on the calling thread, and returns once every copy has returned. False (and
+     * job is not run) if the pool is busy. If a copy throws, the first exception is rethrown here, after every copy has
+     * returned (job must stay alive until then) and the pool is free again */
+    bool run(unsigned int const& n_helpers, std::function<void()> const& job) {
+        // A flag rather than a mutex, so a nested call from the thread that holds the pool just fails to claim it
+        bool expected = false;
+        if(is_worker || !busy.compare_exchange_strong(expected, true, std::memory_order_acquire)) return false;
+        struct BusyRelease {
+            std::atomic<bool>& busy;
+            ~BusyRelease() { busy.store(false, std::memory_order_release); }
+        } busy_release{busy};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while(threads.size() < n_helpers) {
+                threads.emplace_back([this]() { work(); });
+            }
+            current_job = &job;
+            n_requested = n_helpers;
+            n_claimed = 0;
+            n_running = n_helpers;
+            first_exception = nullptr;
+            generation++;
+        }
+        wake.notify_all();
+        try {
+            job();
+        } catch(...) {
+            keep_exception(std::current_exception());
+        }
+        std::exception_ptr exception;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return n_running == 0; });
+            current_job = nullptr;
+            exception = std::exchange(first_exception, nullptr);
+        }
+        if(exception) std::rethrow_exception(exception);
+        return true;
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    WorkerPool() = default;
+
+    void work() {
+        is_worker = true;
+        unsigned int last_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            // Each job is claimed by n_requested threads at most once each. The others go back to sleep
+            wake.wait(lock, [&]() { return stopping || (generation != last_generation && n_claimed < n_requested); });
+            if(stopping) return;
+            last_generation = generation;
+            n_claimed++;
+            std::function<void()> const* job = current_job;
+            lock.unlock();
+            try {
+                (*job)();
+            } catch(...) {
+                keep_exception(std::current_exception());
+            }
+            lock.lock();
+            if(--n_running == 0) done.notify_one();
+        }
+    }
+
+    // Keeps the first exception thrown by a copy of the running job, for run to rethrow
+    void keep_exception(std::exception_ptr const& exception) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!first_exception) first_exception = exception;
+    }
+
+    std::atomic<bool> busy{false}; // Set by the caller of the running job
+    std::mutex mutex; // Guards everything below
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<std::thread> threads;
+    std::function<void()> const* current_job = nullptr;
+    unsigned int generation = 0;
+    unsigned int n_requested = 0;
+    unsigned int n_claimed = 0;
+    unsigned int n_running = 0;
+    std::exception_ptr first_exception;
+    bool stopping = false;
+    static inline thread_local bool is_worker = false;
+};
+
+/* Runs task(slab) for every slab in [0, n_slabs) on n_threads threads of the shared WorkerPool (the calling thread is one of
+ * them). Slabs are handed out one at a time through an atomic counter so uneven slabs balance out. Every slab is processed
+ * by exactly one thread, so tasks that only write to their own slab's part of a pre-sized output are race free and
+ * deterministic, whatever the number of threads that actually ran. */
+template<typename Task>
+void parallel_for_slabs(unsigned int const& n_slabs, unsigned int const& n_threads, Task const& task) {
+    unsigned int n_workers = std::min(n_threads, n_slabs);
+    if(n_workers <= 1) {
+        for(unsigned int slab = 0; slab < n_slabs; slab++) {
+            task(slab);
+        }
+        return;
+    }
+
+    std::atomic<unsigned int> next_slab{0};
+    std::function<void()> worker = [&]() {
+        for(unsigned int slab = next_slab++; slab < n_slabs; slab = next_slab++) {
+            task(slab);
+        }
+    };
+    if(!WorkerPool::get().run(n_workers - 1, worker)) {
+        worker(); // Pool busy, every slab runs on the calling thread
+    }
+}
+
+#endif //MARCHING_CUBES_POINT_CLOUD_PARALLEL_HPP
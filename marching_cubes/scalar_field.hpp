@@ -0,0 +1,43 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_SCALAR_FIELD_HPP
+#define MARCHING_CUBES_POINT_CLOUD_SCALAR_FIELD_HPP
+
+#include <vector>
+#include <variant>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+// Storage width of the scalar field. Picked with "scalar_field_type" in the .config file
+enum class ScalarFieldType {
+    int32,  // Full range
+    uint16, // Distances saturate at 65535
+    uint8   // Distances saturate at 255
+};
+
+// Scalar values at the grid vertices, stored with the width picked at runtime
+using ScalarField = std::variant<std::vector<int>, std::vector<std::uint16_t>, std::vector<std::uint8_t>>;
+
+/* Converts an integer distance to the storage type. Narrow types saturate at their max value: meshes are unchanged as long as
+ * the isovalue + 1 and the distances along bipolar edges fit in the type (see scalar_field_fits) */
+template<typename Scalar>
+Scalar saturate_scalar(int const& value) {
+    if constexpr (std::is_same_v<Scalar, int>) {
+        return value;
+    } else {
+        return (Scalar)std::clamp(value, 0, (int)std::numeric_limits<Scalar>::max());
+    }
+}
+
+/* True if the scalar values needed to extract the surface at this isovalue can be represented by the storage type.
+ * Bipolar edges have a negative end (<= isovalue) so their positive end is at most one cell further (+1 for truncation) */
+template<typename Scalar>
+bool scalar_field_fits(int const& isovalue, float const& grid_scale) {
+    return (long long)isovalue + 2 + (long long)grid_scale < (long long)std::numeric_limits<Scalar>::max();
+}
+
+#endif //MARCHING_CUBES_POINT_CLOUD_SCALAR_FIELD_HPP
@@ -0,0 +1,182 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "sparse_grid.hpp"
+#include "parallel.hpp"
+#include "../third_party/glm/include/glm/glm.hpp"
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+SparseBlock const* SparseGrid::find_block(glm::ivec3 const& block_ijk) const {
+    if(glm::any(glm::lessThan(block_ijk, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(block_ijk, block_dims))) {
+        return nullptr;
+    }
+    auto it = block_lookup.find(block_key(block_ijk));
+    return (it == block_lookup.end()) ? nullptr : &blocks[it->second];
+}
+
+std::size_t SparseGrid::active_vertex_count() const {
+    if(blocks.empty()) return 0;
+    SparseBlock const& last = blocks.back();
+    return last.first_vertex + (std::size_t)last.extent.x * last.extent.y * last.extent.z;
+}
+
+/* Allocates every block which overlaps the box of half size band_radius around a point. band_radius is isovalue + 1 (covers the
+ * truncation of distances to ints) plus one cell, so both ends of every bipolar edge, and every corner of a cube with a negative
+ * corner, are inside the band. Everything outside is further than the isovalue from every point, ie. positive. */
+SparseGrid create_sparse_grid(std::vector<glm::vec3> const& point_cloud_vertices, GridDescriptor const& descriptor, int const& isovalue) {
+    std::cout << "Creating sparse grid" << std::endl;
+    SparseGrid grid;
+    grid.descriptor = descriptor;
+    glm::ivec3 const& dims = descriptor.dims; // Number of vertices along each axis
+    float const scale = descriptor.scale;
+    grid.block_dims = (dims + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE;
+    grid.background_value = isovalue + 2 + (int)std::ceil(scale);
+    std::cout << "Grid dimensions: " << dims.x - 2 << " x " << dims.y - 2 << " x " << dims.z - 2 << std::endl;
+
+    float band_radius = (isovalue + 1 + scale) / scale; // In grid units
+    for(auto const& point : point_cloud_vertices) {
+        glm::vec3 grid_point = (point - descriptor.origin) / scale;
+        glm::ivec3 min_vertex = glm::clamp(glm::ivec3(glm::floor(grid_point - band_radius)), glm::ivec3(0), dims - 1);
+        glm::ivec3 max_vertex = glm::clamp(glm::ivec3(glm::ceil(grid_point + band_radius)), glm::ivec3(0), dims - 1);
+        glm::ivec3 min_block = min_vertex / SPARSE_BLOCK_SIZE;
+        glm::ivec3 max_block = max_vertex / SPARSE_BLOCK_SIZE;
+
+        for(int bi = min_block.x; bi <= max_block.x; bi++) {
+            for(int bj = min_block.y; bj <= max_block.y; bj++) {
+                for(int bk = min_block.z; bk <= max_block.z; bk++) {
+                    glm::ivec3 block_ijk{bi, bj, bk};
+                    auto [it, inserted] = grid.block_lookup.try_emplace(grid.block_key(block_ijk), grid.blocks.size());
+                    if(!inserted) continue;
+
+                    SparseBlock& block = grid.blocks.emplace_back();
+                    block.origin = block_ijk * SPARSE_BLOCK_SIZE;
+                    block.extent = glm::min(glm::ivec3(SPARSE_BLOCK_SIZE), dims - block.origin);
+                    std::fill(std::begin(block.scalar_values), std::end(block.scalar_values), grid.background_value);
+                    std::fill(std::begin(block.classification), std::end(block.classification), ~std::uint64_t{0});
+                }
+            }
+        }
+    }
+
+    std::size_t first_vertex = 0;
+    for(auto& block : grid.blocks) {
+        block.first_vertex = first_vertex;
+        first_vertex += (std::size_t)block.extent.x * block.extent.y * block.extent.z;
+    }
+    std::cout << "Allocated " << grid.blocks.size() << " blocks (" << first_vertex << " of " << (std::size_t)dims.x * dims.y * dims.z
+              << " vertices)" << std::endl;
+    return grid;
+}
+
+/* Nearest point query for every vertex in the allocated blocks, with the same integer distances as the dense field.
+ * Searches are bounded by background_value, so vertices far from any point are clamped to it. */
+void calculate_distance_field(SparseGrid& grid, KDTree const& point_cloud_tree, unsigned int const& n_threads) {
+    std::cout << "Calculating distance field with " << grid.active_vertex_count() << " vertices (sparse grid)" << std::endl;
+    parallel_for_slabs(grid.blocks.size(), n_threads, [&](unsigned int block_idx) {
+        SparseBlock& block = grid.blocks[block_idx];
+        for(int i = 0; i < block.extent.x; i++) {
+            for(int j = 0; j < block.extent.y; j++) {
+                for(int k = 0; k < block.extent.z; k++) {
+                    glm::ivec3 local{i, j, k};
+                    block.scalar_values[SparseBlock::local_index(local)] =
+                            point_cloud_tree.nearest_distance(grid.position(block.origin + local), grid.background_value);
+                }
+            }
+        }
+    });
+}
+
+void classify_grid_vertices(SparseGrid& grid, int const& isovalue) {
+    float const isovalue_05 = isovalue + 0.5;
+    for(auto& block : grid.blocks) {
+        for(int word = 0; word < SPARSE_BLOCK_VOLUME / 64; word++) {
+            std::uint64_t bits = 0;
+            for(int bit = 0; bit < 64; bit++) {
+                bits |= std::uint64_t{block.scalar_values[word * 64 + bit] >= isovalue_05} << bit;
+            }
+            block.classification[word] = bits;
+        }
+    }
+}
+
+void get_active_vertices(SparseGrid const& grid, std::vector<glm::vec3>& positions, std::vector<int>& scalar_values,
+                         VertexClassification& classification) {
+    std::size_t n_vertices = grid.active_vertex_count();
+    positions.clear();
+    scalar_values.clear();
+    positions.reserve(n_vertices);
+    scalar_values.reserve(n_vertices);
+    classification = VertexClassification(n_vertices);
+
+    for(auto const& block : grid.blocks) {
+        for(int i = 0; i < block.extent.x; i++) {
+            for(int j = 0; j < block.extent.y; j++) {
+                for(int k = 0; k < block.extent.z; k++) {
+                    glm::ivec3 local{i, j, k};
+                    int vertex = SparseBlock::local_index(local);
+                    classification.set(positions.size(), block.get_classification(vertex));
+                    positions.push_back(grid.position(block.origin + local));
+                    scalar_values.push_back(block.scalar_values[vertex]);
+                }
+            }
+        }
+    }
+}
+
+/* Classifies the edges from each allocated vertex to its +i, +j, +k neighbours, if the neighbour is also allocated.
+ * Edge values follow the dense classify_grid_edges. Throws std::length_error if the active vertices do not fit 32-bit indices,
+ * same as create_regular_grid. */
+EdgeClassification classify_grid_edges(SparseGrid const& grid, std::vector<uint32_t>& grid_edges) {
+    std::cout << "Classifying grid edges" << std::endl;
+    EdgeClassification edge_values;
+    glm::ivec3 const& dims = grid.descriptor.dims;
+    std::size_t n_vertices = grid.active_vertex_count();
+    if(n_vertices > 0 && n_vertices - 1 > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Sparse grid has " + std::to_string(n_vertices) + " active vertices, too many for 32-bit edge indices");
+    }
+
+    // Index of a vertex in the active vertex list. Fits 32 bits, checked above
+    auto get_index = [](SparseBlock const& block, glm::ivec3 const& local) -> uint32_t {
+        return static_cast<uint32_t>(block.first_vertex + (local.x * block.extent.y + local.y) * block.extent.z + local.z);
+    };
+
+    for(auto const& block : grid.blocks) {
+        for(int i = 0; i < block.extent.x; i++) {
+            for(int j = 0; j < block.extent.y; j++) {
+                for(int k = 0; k < block.extent.z; k++) {
+                    glm::ivec3 local{i, j, k};
+                    for(int axis = 0; axis < 3; axis++) {
+                        glm::ivec3 neighbour = block.origin + local;
+                        neighbour[axis]++;
+                        if(neighbour[axis] >= dims[axis]) continue;
+
+                        SparseBlock const* neighbour_block = &block;
+                        glm::ivec3 neighbour_local = local;
+                        neighbour_local[axis]++;
+                        if(neighbour_local[axis] == SPARSE_BLOCK_SIZE) {
+                            neighbour_block = grid.find_block(neighbour / SPARSE_BLOCK_SIZE);
+                            if(neighbour_block == nullptr) continue;
+                            neighbour_local[axis] = 0;
+                        }
+
+                        uint32_t idx1 = get_index(block, local);
+                        uint32_t idx2 = get_index(*neighbour_block, neighbour_local);
+                        edge_values.push_back(EdgeClassification::get_edge_value(
+                                block.get_classification(SparseBlock::local_index(local)),
+                                neighbour_block->get_classification(SparseBlock::local_index(neighbour_local))));
+                        grid_edges.push_back(idx1);
+                        grid_edges.push_back(idx2);
+                    }
+                }
+            }
+        }
+    }
+    return edge_values;
+}
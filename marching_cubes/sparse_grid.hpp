@@ -0,0 +1,74 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_SPARSE_GRID_HPP
+#define MARCHING_CUBES_POINT_CLOUD_SPARSE_GRID_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/vec3.hpp>
+
+#include "distance_field.hpp"
+#include "kd_tree.hpp"
+
+constexpr int SPARSE_BLOCK_SIZE = 8; // Grid vertices along each axis of a block
+constexpr int SPARSE_BLOCK_VOLUME = SPARSE_BLOCK_SIZE * SPARSE_BLOCK_SIZE * SPARSE_BLOCK_SIZE;
+
+// A block of 8x8x8 grid vertices. Only blocks close to the point cloud are allocated.
+struct SparseBlock {
+    glm::ivec3 origin;         // Grid coordinates (ijk) of the first vertex in the block
+    glm::ivec3 extent;         // Number of vertices in the block that are inside the grid (blocks on the far border are cut)
+    std::size_t first_vertex;  // Index of the first vertex of the block in the active vertex list (see get_active_vertices)
+    int scalar_values[SPARSE_BLOCK_VOLUME];
+    std::uint64_t classification[SPARSE_BLOCK_VOLUME / 64]; // 1 bit per vertex: 0 - negative, 1 - positive
+
+    static int local_index(glm::ivec3 const& local) {
+        return (local.x * SPARSE_BLOCK_SIZE + local.y) * SPARSE_BLOCK_SIZE + local.z;
+    }
+
+    unsigned int get_classification(int vertex) const {
+        return (classification[vertex / 64] >> (vertex % 64)) & 1u;
+    }
+};
+
+/* Same grid as create_regular_grid (see GridDescriptor) stored as blocks in a hash map. Only the narrow band of blocks
+ * within isovalue + 1 (plus one cell) of some point is allocated. Every vertex outside the band is positive and has background_value as its scalar value. */
+struct SparseGrid {
+    GridDescriptor descriptor; // The full grid the blocks are part of
+    glm::ivec3 block_dims; // Number of blocks along each axis
+    int background_value;  // Scalar value of the vertices outside the band. Distances are clamped to this value
+    std::vector<SparseBlock> blocks;
+    std::unordered_map<std::uint64_t, unsigned int> block_lookup; // Block key -> index in blocks
+
+    std::uint64_t block_key(glm::ivec3 const& block_ijk) const {
+        return ((std::uint64_t)block_ijk.x * block_dims.y + block_ijk.y) * block_dims.z + block_ijk.z;
+    }
+    // nullptr if the block is not allocated (or outside the grid)
+    SparseBlock const* find_block(glm::ivec3 const& block_ijk) const;
+
+    glm::vec3 position(glm::ivec3 const& ijk) const {
+        return descriptor.position(ijk);
+    }
+    std::size_t active_vertex_count() const;
+};
+
+// Allocates the band of blocks of the grid around the point cloud.
+SparseGrid create_sparse_grid(std::vector<glm::vec3> const& point_cloud_vertices, GridDescriptor const& grid, int const& isovalue);
+
+// Finds scalar value of every vertex in the allocated blocks, clamped to background_value. Blocks are evaluated on n_threads threads
+void calculate_distance_field(SparseGrid& grid, KDTree const& point_cloud_tree, unsigned int const& n_threads);
+
+// Classifies vertices in the allocated blocks as positive, negative. Same rule as the dense classify_grid_vertices
+void classify_grid_vertices(SparseGrid& grid, int const& isovalue);
+
+// Flattens the allocated vertices into vectors (for rendering). Indices into these vectors are the ones used by classify_grid_edges
+void get_active_vertices(SparseGrid const& grid, std::vector<glm::vec3>& positions, std::vector<int>& scalar_values,
+                         VertexClassification& classification);
+
+// Same as the dense classify_grid_edges, for the edges between allocated vertices. Populates grid_edges with the indices of
+// their two ends in the active vertex list. Throws std::length_error if there are too many active vertices for 32-bit indices
+EdgeClassification classify_grid_edges(SparseGrid const& grid, std::vector<uint32_t>& grid_edges);
+
+#endif //MARCHING_CUBES_POINT_CLOUD_SPARSE_GRID_HPP
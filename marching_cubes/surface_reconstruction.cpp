@@ -5,8 +5,16 @@
 #include "surface_reconstruction.hpp"
 #include "distance_field.hpp"
 #include "mc_tables.h"
+#include "parallel.hpp"
+#include "case_index.hpp"
 #include "../render/labutils/render_constants.hpp"
 
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <bit>
+#include <cstring>
+
 
 
 /* Returns case index in the 256 case table. Important - in order for this to work, the  vertex values
@@ -14,18 +22,21 @@
 unsigned int get_case(unsigned int const (&vertex_values)[8]) {
     unsigned int cube_idx = 0;
 
-    if (vertex_values[0] == 1) cube_idx |= 1;
-    if (vertex_values[1] == 1) cube_idx |= 2;
-    if (vertex_values[2] == 1) cube_idx |= 4;
-    if (vertex_values[3] == 1) cube_idx |= 8;
-    if (vertex_values[4] == 1) cube_idx |= 16;
-    if (vertex_values[5] == 1) cube_idx |= 32;
-    if (vertex_values[6] == 1) cube_idx |= 64;
-    if (vertex_values[7] == 1) cube_idx |= 128;
+    for(unsigned int n = 0; n < 8; n++) {
+        cube_idx |= (unsigned int)(vertex_values[n] == 1) << n;
+    }
 
     return cube_idx;
 }
 
+/* Returns case index from the classification of the four rows of cube vertices along k. Each row holds the vertex at k in
+ * bit 0 and the vertex at k + 1 in bit 1. Rows (i, j), (i, j+1), (i+1, j), (i+1, j+1) hold cube vertices 0 & 2, 1 & 3,
+ * 4 & 6 and 5 & 7 (see mc_tables.h), so each row is spread to bits n and n + 2 and shifted into place. */
+unsigned int get_case(unsigned int const& row_00, unsigned int const& row_01, unsigned int const& row_10, unsigned int const& row_11) {
+    auto spread = [](unsigned int row) -> unsigned int { return (row & 1u) | ((row & 2u) << 1); };
+    return spread(row_00) | (spread(row_01) << 1) | (spread(row_10) << 4) | (spread(row_11) << 5);
+}
+
 /* Given two points on the edge where a vertex should be inserted according to the case tables,
  * use their scalar values and positions to interpolate the triangle's vertex.
  * ----> Returns interpolated vertex position between two points according to scalar value */
@@ -43,6 +54,277 @@ glm::vec3 linear_interpolation(glm::vec3 const& point_1, glm::vec3 const& point_
     return interpolated_position;
 }
 
+namespace {
+    // Offsets of the cube vertices from the first one (i, j, k), in the order described in mc_tables.h
+    glm::ivec3 const cube_offsets[8] = {{0, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 1, 1},
+                                        {1, 0, 0}, {1, 1, 0}, {1, 0, 1}, {1, 1, 1}};
+
+    // A cube edge as the offset of its first vertex from the cube's first vertex and its axis (0 - x, 1 - y, 2 - z).
+    // The first vertex of every edge in edgeTable is its min corner, so an edge is the same grid edge in every cube sharing it
+    struct CubeEdge {
+        glm::ivec3 offset;
+        int axis;
+    };
+    std::array<CubeEdge, 12> const cube_edges = [] {
+        std::array<CubeEdge, 12> edges;
+        for(int e = 0; e < 12; e++) {
+            glm::ivec3 from = cube_offsets[edgeTable[e][0]];
+            glm::ivec3 to = cube_offsets[edgeTable[e][1]];
+            edges[e] = CubeEdge{from, (to.x != from.x) ? 0 : (to.y != from.y) ? 1 : 2};
+        }
+        return edges;
+    }();
+
+    constexpr unsigned int PREVIOUS_SLAB_VERTEX = 1u << 31; // Marks a vertex index as a slot of the previous slab's upper plane
+
+    /* Indices of the mesh vertices already created on the grid edges around the current slab of cubes (from i to i + 1).
+     * Edges along y and z are stored for the two planes of vertices i and i + 1, edges along x for the slab itself, each edge
+     * keyed on its first vertex. -1 if no vertex has been created on the edge yet. Plane i is stored in planes[i % 2], so
+     * moving to the next slab reuses plane i + 1 as plane i, and only two planes are ever stored.
+     * Every slot is stamped with the plane (or slab, for edges along x) it was written for, and a slot with an older stamp is
+     * empty. So moving to the next slab does not clear anything, and only the slots of the edges around active cubes are
+     * ever touched.
+     * Every bipolar edge on plane i also belongs to a cube of slab i - 1, which creates its vertex first. So if the first slab
+     * of the cache is not the first slab of the grid, its lower plane holds PREVIOUS_SLAB_VERTEX | slot instead, which is
+     * resolved when the slabs are merged. */
+    struct SlabEdgeCache {
+        struct Slot {
+            int vertex;
+            int stamp;
+        };
+        int row_size;
+        int slab; // Current slab
+        std::vector<Slot> planes[2]; // [(j * dims.z + k) * 2 + axis - 1]
+        std::vector<Slot> x_edges;   // [j * dims.z + k]
+
+        SlabEdgeCache(glm::ivec3 const& dims, int const& first_slab) : row_size(dims.z), slab(first_slab) {
+            std::size_t plane_size = (std::size_t)dims.y * dims.z;
+            for(auto* slots : {&planes[0], &planes[1]}) {
+                slots->assign(plane_size * 2, Slot{-1, -1});
+            }
+            x_edges.assign(plane_size, Slot{-1, -1});
+            if(first_slab > 0) {
+                std::vector<Slot>& lower_plane = planes[first_slab % 2];
+                for(std::size_t slot = 0; slot < lower_plane.size(); slot++) {
+                    lower_plane[slot] = Slot{(int)(PREVIOUS_SLAB_VERTEX | slot), first_slab};
+                }
+            }
+        }
+
+        // Slot of the edge starting at vertex (i + plane, j, k)
+        int& get_slot(int plane, int j, int k, int axis) {
+            std::size_t vertex = (std::size_t)j * row_size + k;
+            int stamp = slab + plane;
+            Slot& slot = (axis == 0) ? x_edges[vertex] : planes[stamp % 2][vertex * 2 + axis - 1];
+            if(slot.stamp != stamp) slot = Slot{-1, stamp};
+            return slot.vertex;
+        }
+
+        // Vertex in the slot of the upper plane of the current slab, -1 if there is none
+        int get_upper_plane_vertex(std::size_t slot) const {
+            Slot const& upper = planes[(slab + 1) % 2][slot];
+            return (upper.stamp == slab + 1) ? upper.vertex : -1;
+        }
+
+        std::size_t plane_slot_count() const {
+            return planes[0].size();
+        }
+
+        void next_slab() {
+            slab++;
+        }
+    };
+
+    // Faces of the cube each cube edge is on, one bit per face: bit axis * 2 is the face on the first vertex's side along the axis,
+    // bit axis * 2 + 1 the opposite one
+    std::array<unsigned int, 12> const cube_edge_faces = [] {
+        std::array<unsigned int, 12> faces{};
+        for(int e = 0; e < 12; e++) {
+            for(int axis = 0; axis < 3; axis++) {
+                if(axis != cube_edges[e].axis) faces[e] |= 1u << (axis * 2 + cube_edges[e].offset[axis]);
+            }
+        }
+        return faces;
+    }();
+
+    /* Halfedges waiting for their other half on the faces between the cubes around the current slab. A mesh edge on the face
+     * between two cubes belongs to a triangle of each, in opposite directions. The cube visited first (the lower one along the
+     * face's axis) leaves its halfedge on the face, and the other cube takes it. A face holds at most 2 mesh edges (ambiguous
+     * faces), -1 marks an empty entry. Faces along x are stored for the planes below and above the slab, like SlabEdgeCache. */
+    struct SlabFaceCache {
+        int row_size;
+        glm::ivec2 plane_dims;
+        std::vector<std::array<int, 2>> x_planes[2]; // [j * row_size + k]: face below (plane 0) or above (plane 1) cube (i, j, k)
+        std::vector<std::array<int, 2>> y_faces;     // [j * row_size + k]: face between cubes (i, j, k) and (i, j + 1, k)
+        std::vector<std::array<int, 2>> z_faces;     // [j * row_size + k]: face between cubes (i, j, k) and (i, j, k + 1)
+
+        explicit SlabFaceCache(glm::ivec3 const& cube_dims) : row_size(cube_dims.z), plane_dims(cube_dims.y, cube_dims.z) {
+            std::size_t plane_size = (std::size_t)cube_dims.y * cube_dims.z;
+            for(auto* faces : {&x_planes[0], &x_planes[1], &y_faces, &z_faces}) {
+                faces->assign(plane_size, {-1, -1});
+            }
+        }
+
+        // Face of cube (i, j, k) (see cube_edge_faces). nullptr for the faces on the lower border of the grid
+        std::array<int, 2>* get_face(glm::ivec3 const& ijk, int face) {
+            int side = face % 2;
+            switch(face / 2) {
+                case 0: return &x_planes[side][(std::size_t)ijk.y * row_size + ijk.z];
+                case 1: return (ijk.y + side == 0) ? nullptr : &y_faces[(std::size_t)(ijk.y + side - 1) * row_size + ijk.z];
+                default: return (ijk.z + side == 0) ? nullptr : &z_faces[(std::size_t)ijk.y * row_size + ijk.z + side - 1];
+            }
+        }
+
+        void next_slab() {
+            std::swap(x_planes[0], x_planes[1]);
+            for(auto* faces : {&x_planes[1], &y_faces, &z_faces}) {
+                std::fill(faces->begin(), faces->end(), std::array<int, 2>{-1, -1});
+            }
+        }
+    };
+
+    // Mesh extracted from a range of slabs of cubes. Vertex indices are local to the range (see SlabEdgeCache)
+    struct SlabMesh {
+        IndexedMesh mesh;
+        std::vector<std::pair<unsigned int, unsigned int>> upper_plane_vertices; // (slot, local index) of the vertices on the last plane, sorted by slot
+
+        // Keeps the vertices on the last plane of the range, for the next range to weld its first plane to
+        void keep_upper_plane_vertices(SlabEdgeCache const& edge_cache) {
+            for(std::size_t slot = 0; slot < edge_cache.plane_slot_count(); slot++) {
+                int vertex = edge_cache.get_upper_plane_vertex(slot);
+                if(vertex != -1) upper_plane_vertices.emplace_back(slot, vertex);
+            }
+        }
+    };
+
+    // A cube active at some isovalue of a batch, with the scalar values of its corners (see query_case_table_batch)
+    struct BatchCube {
+        glm::ivec3 ijk;
+        int scalars[8];
+    };
+
+    /* Merges the meshes of consecutive ranges of slabs in order, with a prefix sum over their sizes. Vertices and faces are laid
+     * out exactly as if the slabs had been extracted one after the other */
+    IndexedMesh merge_slab_meshes(std::vector<SlabMesh>& slab_meshes, unsigned int const& n_threads) {
+        std::size_t const n_ranges = slab_meshes.size();
+        if(n_ranges == 1) return std::move(slab_meshes[0].mesh);
+        std::vector<std::size_t> first_vertex(n_ranges + 1, 0), first_index(n_ranges + 1, 0);
+        for(std::size_t range = 0; range < n_ranges; range++) {
+            first_vertex[range + 1] = first_vertex[range] + slab_meshes[range].mesh.positions.size();
+            first_index[range + 1] = first_index[range] + slab_meshes[range].mesh.face_indices.size();
+        }
+        IndexedMesh indexedMesh;
+        indexedMesh.positions.resize(first_vertex[n_ranges]);
+        indexedMesh.face_indices.resize(first_index[n_ranges]);
+
+        parallel_for_slabs(n_ranges, n_threads, [&](unsigned int range) {
+            IndexedMesh const& slabMesh = slab_meshes[range].mesh;
+            std::copy(slabMesh.positions.begin(), slabMesh.positions.end(), indexedMesh.positions.begin() + first_vertex[range]);
+            for(std::size_t idx = 0; idx < slabMesh.face_indices.size(); idx++) {
+                unsigned int vertex = slabMesh.face_indices[idx];
+                if(vertex & PREVIOUS_SLAB_VERTEX) {
+                    // Welds the vertex to the one created on the same edge by the previous range
+                    auto const& previous = slab_meshes[range - 1].upper_plane_vertices;
+                    auto it = std::lower_bound(previous.begin(), previous.end(), std::make_pair(vertex & ~PREVIOUS_SLAB_VERTEX, 0u));
+                    vertex = first_vertex[range - 1] + it->second;
+                } else {
+                    vertex += first_vertex[range];
+                }
+                indexedMesh.face_indices[first_index[range] + idx] = vertex;
+            }
+        });
+        return indexedMesh;
+    }
+
+    /* Looks up the triangles of the cube's case (see caseTable) and adds them to the mesh, interpolating their vertices along the
+     * cube edges. Cube vertex positions and scalar values are in the order described in mc_tables.h.
+     * edge_slot(edge) returns the index of the vertex on that cube edge (see cube_edges), shared with the other cubes around the
+     * edge. A slot holding -1 has no vertex yet, so the vertex is created and its index stored. This welds the mesh on the grid
+     * edges that produced the vertices, instead of comparing positions. */
+    template<typename EdgeSlot>
+    void march_cube(unsigned int const& case_index, glm::vec3 const (&vertex_positions)[8], int const (&vertex_scalars)[8],
+                    float const& isovalue, IndexedMesh& indexedMesh, EdgeSlot&& edge_slot) {
+        CaseTableEntry const& case_entry = caseTable[case_index];
+
+        // Every intersected edge once, so each vertex is looked up (or interpolated) once per cube
+        int edge_vertices[12];
+        for(unsigned int n = 0; n < case_entry.n_edges; n++) {
+            int edge_idx = case_entry.edges[n];
+            int& vertex_idx = edge_slot(edge_idx);
+            if(vertex_idx == -1) {
+                int const* edge = edgeTable[edge_idx]; // An edge is described as the two vertices at the end
+                vertex_idx = indexedMesh.positions.size();
+                indexedMesh.positions.push_back(linear_interpolation(vertex_positions[edge[0]], vertex_positions[edge[1]],
+                                                                     vertex_scalars[edge[0]], vertex_scalars[edge[1]], isovalue));
+            }
+            edge_vertices[n] = vertex_idx;
+        }
+        for(unsigned int n = 0; n < case_entry.n_triangles * 3u; n++) {
+            indexedMesh.face_indices.push_back(edge_vertices[case_entry.triangles[n]]);
+        }
+    }
+}
+
+/* Finds the cubes which are not all positive or all negative, ie. have a bipolar edge. These are exactly the cubes which produce
+ * triangles. Each i-slab is scanned in parallel along k in chunks of 56 cubes, using the classification of the four rows of
+ * vertices the cubes touch (see get_case): a cube is active if the OR of its corner bits is 1 and the AND is 0, which is
+ * computed for the whole chunk at once. Chunks far from the surface are skipped with a single comparison, the cases of the
+ * others are computed together with SIMD (see get_chunk_cases).
+ * Returns the active cubes in grid order with their cases */
+ActiveCells get_active_cells(VertexClassification const& grid_classification, GridDescriptor const& grid, unsigned int const& n_threads) {
+    std::cout << "Finding active cubes (" << case_index_kernel_name() << " case indices)" << std::endl;
+    constexpr int CUBES_PER_CHUNK = 56; // A chunk of cubes along k needs one more vertex classification bit (57 max, see get_bits)
+    glm::ivec3 const cube_dims = grid.dims - 1;
+    std::vector<ActiveCells> slab_cells(cube_dims.x);
+
+    parallel_for_slabs(cube_dims.x, n_threads, [&](unsigned int slab) {
+        int const i = slab;
+        ActiveCells& active = slab_cells[slab];
+        for(int j = 0; j < cube_dims.y; j++) {
+            // First vertex of the four rows of vertices along k touched by the cubes
+            std::size_t const rows[4] = {grid.get_index(i, j, 0), grid.get_index(i, j + 1, 0),
+                                         grid.get_index(i + 1, j, 0), grid.get_index(i + 1, j + 1, 0)};
+
+            for(int chunk_k = 0; chunk_k < cube_dims.z; chunk_k += CUBES_PER_CHUNK) {
+                unsigned int chunk_size = std::min(CUBES_PER_CHUNK, cube_dims.z - chunk_k);
+                std::uint64_t row_bits[4];
+                for(unsigned int row = 0; row < 4; row++) {
+                    row_bits[row] = grid_classification.get_bits(rows[row] + chunk_k, chunk_size + 1);
+                }
+                // Cube at bit n has corners at bits n and n + 1 of every row
+                std::uint64_t any_positive = 0, all_positive = ~std::uint64_t{0};
+                for(unsigned int row = 0; row < 4; row++) {
+                    any_positive |= row_bits[row] | (row_bits[row] >> 1);
+                    all_positive &= row_bits[row] & (row_bits[row] >> 1);
+                }
+                std::uint64_t mixed = any_positive & ~all_positive & ((std::uint64_t{1} << chunk_size) - 1);
+                if(mixed == 0) continue;
+
+                std::uint8_t chunk_cases[CASE_CHUNK_SIZE];
+                get_chunk_cases(row_bits, chunk_cases);
+                for(; mixed != 0; mixed &= mixed - 1) {
+                    unsigned int cube = std::countr_zero(mixed);
+                    active.cells.emplace_back(i, j, chunk_k + (int)cube);
+                    active.cases.push_back(chunk_cases[cube]);
+                }
+            }
+        }
+    });
+
+    ActiveCells active;
+    active.slab_begin.resize(cube_dims.x + 1, 0);
+    for(int slab = 0; slab < cube_dims.x; slab++) {
+        active.slab_begin[slab + 1] = active.slab_begin[slab] + slab_cells[slab].cells.size();
+    }
+    active.cells.reserve(active.slab_begin.back());
+    active.cases.reserve(active.slab_begin.back());
+    for(auto const& slab : slab_cells) {
+        active.cells.insert(active.cells.end(), slab.cells.begin(), slab.cells.end());
+        active.cases.insert(active.cases.end(), slab.cases.begin(), slab.cases.end());
+    }
+    return active;
+}
+
 //  Axes are:
 //
 //      z
@@ -64,125 +346,701 @@ glm::vec3 linear_interpolation(glm::vec3 const& point_1, glm::vec3 const& point_
 //    0 +-------------+ 4             +------8------+
 // Diagram inspired by: https://gist.github.com/dwilliamson/c041e3454a713e58baf6e4f8e5fffecd
 /* The diagram refers to the layout desribed in mc_tables.h
- * Given the grid values ( 0 or 1 - negative or positive), iterate and for each cube find its case.
+ * Given the grid values ( 0 or 1 - negative or positive), find the active cubes and their cases (see get_active_cells).
+ * Contiguous ranges of i-slabs of cubes are extracted in parallel into their own meshes, which are then concatenated in order
+ * with a prefix sum over their sizes. Vertices on the plane between two ranges are welded to the ones created by the lower
+ * range, so the result is the same as extracting every slab in order, for any number of threads.
  * Returns a vector of points where each triple(3) of vec3s define a triangle */
-IndexedMesh query_case_table(std::vector<unsigned int> const& grid_classification,  std::vector<glm::vec3> const& grid_positions,
-                                        std::vector<int> const& grid_scalar_values, float const& grid_resolution, BoundingBox const& model_bbox,
-                                        float const& input_isovalue) {
+template<typename Scalar>
+IndexedMesh query_case_table(VertexClassification const& grid_classification, std::vector<Scalar> const& grid_scalar_values,
+                             GridDescriptor const& grid, float const& input_isovalue, unsigned int const& n_threads) {
 
-    IndexedMesh indexedMesh;
-    // Function to add a vertex to indexed mesh or get its index if it already exists
-    auto set_vertex = [&](const glm::vec3& v) -> int {
-        auto it = indexedMesh.vertex_idx_map.find(v);
-        if (it != indexedMesh.vertex_idx_map.end()) {
-            // Vertex already exists, return its index
-            return it->second;
-        } else {
-            // Vertex does not exist, add it to the vector and map
-            indexedMesh.positions.push_back(v);
-            int newIndex = indexedMesh.positions.size() - 1;
-            indexedMesh.vertex_idx_map[v] = newIndex;
-            return newIndex;
+     float isovalue = input_isovalue + 0.5; //TODO: Might be nicer to shift this elsewhere.
+    std::cout << "Classifying all cubes in the grid" << std::endl;
+
+    ActiveCells const active = get_active_cells(grid_classification, grid, n_threads);
+    int const n_slabs = grid.dims.x - 1;
+    // Contiguous ranges of slabs. More ranges than threads balance the load, but each range starts with a fresh edge cache
+    unsigned int const n_ranges = (n_threads <= 1) ? 1 : std::min<unsigned int>(n_slabs, n_threads * 4);
+    std::vector<SlabMesh> slab_meshes(n_ranges);
+
+    parallel_for_slabs(n_ranges, n_threads, [&](unsigned int range) {
+        int const first_slab = (std::size_t)n_slabs * range / n_ranges;
+        int const last_slab = (std::size_t)n_slabs * (range + 1) / n_ranges;
+        IndexedMesh& slabMesh = slab_meshes[range].mesh;
+        SlabEdgeCache edge_cache(grid.dims, first_slab);
+        for(int i = first_slab; i < last_slab; i++) {
+            if(i > first_slab) edge_cache.next_slab();
+            //Only the cubes which produce triangles are visited
+            for(std::size_t cell = active.slab_begin[i]; cell < active.slab_begin[i + 1]; cell++) {
+                glm::ivec3 const& ijk = active.cells[cell];
+                glm::vec3 vertex_positions[8];
+                int vertex_scalars[8];
+                for(unsigned int n = 0; n < 8; n++) {
+                    vertex_positions[n] = grid.position(ijk + cube_offsets[n]);
+                    vertex_scalars[n] = grid_scalar_values[grid.get_index(ijk + cube_offsets[n])];
+                }
+                march_cube(active.cases[cell], vertex_positions, vertex_scalars, isovalue, slabMesh, [&](int edge) -> int& {
+                    CubeEdge const& cube_edge = cube_edges[edge];
+                    return edge_cache.get_slot(cube_edge.offset.x, ijk.y + cube_edge.offset.y, ijk.z + cube_edge.offset.z, cube_edge.axis);
+                });
+            }
+        }
+
+        if(range + 1 < n_ranges) slab_meshes[range].keep_upper_plane_vertices(edge_cache);
+    });
+
+    return merge_slab_meshes(slab_meshes, n_threads);
+}
+
+template IndexedMesh query_case_table<int>(VertexClassification const&, std::vector<int> const&, GridDescriptor const&, float const&,
+                                           unsigned int const&);
+template IndexedMesh query_case_table<std::uint16_t>(VertexClassification const&, std::vector<std::uint16_t> const&, GridDescriptor const&,
+                                                     float const&, unsigned int const&);
+template IndexedMesh query_case_table<std::uint8_t>(VertexClassification const&, std::vector<std::uint8_t> const&, GridDescriptor const&,
+                                                    float const&, unsigned int const&);
+
+/* Same as query_case_table, for several isovalues in one pass over the scalar field. Every scalar value is loaded once and
+ * classified at all the isovalues, 64 vertices at a time. The active cubes of each isovalue are then found 56 at a time like
+ * in get_active_cells, and a cube active at any of them is visited once: its corner positions and scalar values are loaded
+ * once for all isovalues. With the isovalues sorted, the classification of a corner at every isovalue is given by its level,
+ * the number of isovalues below its scalar value, so a cube is active at the isovalues from its min to its max corner level
+ * and its case index at each of them is the mask of the corners above it.
+ * Each isovalue has its own edge caches and slab meshes, so every mesh is the same as from query_case_table. */
+template<typename Scalar>
+std::vector<IndexedMesh> query_case_table_batch(std::vector<Scalar> const& grid_scalar_values, GridDescriptor const& grid,
+                                                std::vector<int> const& input_isovalues, unsigned int const& n_threads) {
+    std::cout << "Classifying all cubes in the grid at " << input_isovalues.size() << " isovalues" << std::endl;
+    std::size_t const n_isovalues = input_isovalues.size();
+    std::vector<IndexedMesh> meshes(n_isovalues);
+    if(n_isovalues == 0) return meshes;
+
+    // Isovalues in increasing order, so the vertices positive at an isovalue are also positive at the ones below it
+    std::vector<std::size_t> order(n_isovalues);
+    for(std::size_t n = 0; n < n_isovalues; n++) order[n] = n;
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return input_isovalues[a] < input_isovalues[b]; });
+    std::vector<int> sorted_isovalues(n_isovalues);
+    for(std::size_t n = 0; n < n_isovalues; n++) sorted_isovalues[n] = input_isovalues[order[n]];
+
+    /* Same as classify_grid_vertices, at every isovalue. Comparisons are written to bytes, and each 8 bytes (0 or 1) are
+     * gathered into 8 bits with a multiplication, which keeps both steps free of branches and shifts by the vertex.
+     * Ranges of words are classified in parallel */
+    std::vector<VertexClassification> classifications(n_isovalues, VertexClassification(grid_scalar_values.size()));
+    std::size_t const n_words = classifications[0].words.size();
+    unsigned int const n_word_ranges = std::max<std::size_t>(1, std::min<std::size_t>(n_words, n_threads * 4));
+    parallel_for_slabs(n_word_ranges, n_threads, [&](unsigned int word_range) {
+        for(std::size_t word = n_words * word_range / n_word_ranges; word < n_words * (word_range + 1) / n_word_ranges; word++) {
+            std::size_t first = word * 64;
+            std::size_t count = std::min<std::size_t>(64, grid_scalar_values.size() - first);
+            int scalars[64] = {};
+            for(std::size_t vertex = 0; vertex < count; vertex++) scalars[vertex] = grid_scalar_values[first + vertex];
+            std::uint64_t const mask = (count == 64) ? ~std::uint64_t{0} : (std::uint64_t{1} << count) - 1;
+            for(std::size_t level = 0; level < n_isovalues; level++) {
+                int const isovalue = sorted_isovalues[level];
+                std::uint8_t positive[64];
+                for(int vertex = 0; vertex < 64; vertex++) {
+                    positive[vertex] = scalars[vertex] > isovalue; // 1 - Positive, 0 - Negative
+                }
+                std::uint64_t bits = 0;
+                for(int byte = 0; byte < 8; byte++) {
+                    std::uint64_t eight_vertices;
+                    std::memcpy(&eight_vertices, &positive[byte * 8], 8);
+                    bits |= ((eight_vertices * 0x0102040810204080) >> 56) << (byte * 8);
+                }
+                classifications[level].words[word] = bits & mask;
+            }
+        }
+    });
+
+    constexpr int CUBES_PER_CHUNK = 56; // A chunk of cubes along k needs one more vertex classification bit (57 max, see get_bits)
+    glm::ivec3 const& dims = grid.dims;
+    int const n_slabs = dims.x - 1;
+    unsigned int const n_ranges = (n_threads <= 1) ? 1 : std::min<unsigned int>(n_slabs, n_threads * 4);
+    std::vector<std::vector<SlabMesh>> slab_meshes(n_isovalues, std::vector<SlabMesh>(n_ranges));
+
+    parallel_for_slabs(n_ranges, n_threads, [&](unsigned int range) {
+        int const first_slab = (std::size_t)n_slabs * range / n_ranges;
+        int const last_slab = (std::size_t)n_slabs * (range + 1) / n_ranges;
+        std::vector<SlabEdgeCache> edge_caches(n_isovalues, SlabEdgeCache(dims, first_slab));
+        std::vector<BatchCube> cubes; // Cubes of the slab active at any isovalue
+        std::vector<std::vector<std::pair<unsigned int, std::uint8_t>>> level_cubes(n_isovalues); // (cube, case index) at each isovalue
+        for(int i = first_slab; i < last_slab; i++) {
+            cubes.clear();
+            for(auto& active : level_cubes) active.clear();
+            for(int j = 0; j < dims.y - 1; j++) {
+                std::size_t const rows[4] = {grid.get_index(i, j, 0), grid.get_index(i, j + 1, 0),
+                                             grid.get_index(i + 1, j, 0), grid.get_index(i + 1, j + 1, 0)};
+                for(int chunk_k = 0; chunk_k < dims.z - 1; chunk_k += CUBES_PER_CHUNK) {
+                    unsigned int chunk_size = std::min(CUBES_PER_CHUNK, dims.z - 1 - chunk_k);
+                    // Cube at bit n has corners at bits n and n + 1 of every row
+                    std::uint64_t mixed_at_any = 0;
+                    for(auto const& classification : classifications) {
+                        std::uint64_t any_positive = 0, all_positive = ~std::uint64_t{0};
+                        for(std::size_t row : rows) {
+                            std::uint64_t row_bits = classification.get_bits(row + chunk_k, chunk_size + 1);
+                            any_positive |= row_bits | (row_bits >> 1);
+                            all_positive &= row_bits & (row_bits >> 1);
+                        }
+                        mixed_at_any |= any_positive & ~all_positive;
+                    }
+                    for(std::uint64_t mixed = mixed_at_any & ((std::uint64_t{1} << chunk_size) - 1); mixed != 0; mixed &= mixed - 1) {
+                        BatchCube& cube = cubes.emplace_back();
+                        cube.ijk = glm::ivec3{i, j, chunk_k + std::countr_zero(mixed)};
+                        unsigned int corner_levels[8];
+                        unsigned int min_level = n_isovalues, max_level = 0;
+                        for(unsigned int n = 0; n < 8; n++) {
+                            cube.scalars[n] = grid_scalar_values[grid.get_index(cube.ijk + cube_offsets[n])];
+                            corner_levels[n] = 0;
+                            for(int isovalue : sorted_isovalues) corner_levels[n] += cube.scalars[n] > isovalue;
+                            min_level = std::min(min_level, corner_levels[n]);
+                            max_level = std::max(max_level, corner_levels[n]);
+                        }
+                        for(unsigned int level = min_level; level < max_level; level++) {
+                            unsigned int case_index = 0;
+                            for(unsigned int n = 0; n < 8; n++) {
+                                case_index |= (unsigned int)(corner_levels[n] > level) << n;
+                            }
+                            level_cubes[level].emplace_back(cubes.size() - 1, case_index);
+                        }
+                    }
+                }
+            }
+
+            // Each isovalue's cubes are marched together, so only one edge cache is in use at a time
+            for(std::size_t level = 0; level < n_isovalues; level++) {
+                SlabEdgeCache& edge_cache = edge_caches[level];
+                if(i > first_slab) edge_cache.next_slab();
+                for(auto const& [cube_index, case_index] : level_cubes[level]) {
+                    BatchCube const& cube = cubes[cube_index];
+                    glm::vec3 vertex_positions[8];
+                    for(unsigned int n = 0; n < 8; n++) {
+                        vertex_positions[n] = grid.position(cube.ijk + cube_offsets[n]);
+                    }
+                    march_cube(case_index, vertex_positions, cube.scalars, sorted_isovalues[level] + 0.5f,
+                               slab_meshes[order[level]][range].mesh, [&](int edge) -> int& {
+                        CubeEdge const& cube_edge = cube_edges[edge];
+                        return edge_cache.get_slot(cube_edge.offset.x, cube.ijk.y + cube_edge.offset.y, cube.ijk.z + cube_edge.offset.z,
+                                                   cube_edge.axis);
+                    });
+                }
+            }
+        }
+
+        if(range + 1 < n_ranges) {
+            for(std::size_t level = 0; level < n_isovalues; level++) {
+                slab_meshes[order[level]][range].keep_upper_plane_vertices(edge_caches[level]);
+            }
         }
+    });
+
+    for(std::size_t n = 0; n < n_isovalues; n++) {
+        meshes[n] = merge_slab_meshes(slab_meshes[n], n_threads);
+    }
+    return meshes;
+}
+
+template std::vector<IndexedMesh> query_case_table_batch<int>(std::vector<int> const&, GridDescriptor const&, std::vector<int> const&,
+                                                              unsigned int const&);
+template std::vector<IndexedMesh> query_case_table_batch<std::uint16_t>(std::vector<std::uint16_t> const&, GridDescriptor const&,
+                                                                        std::vector<int> const&, unsigned int const&);
+template std::vector<IndexedMesh> query_case_table_batch<std::uint8_t>(std::vector<std::uint8_t> const&, GridDescriptor const&,
+                                                                       std::vector<int> const&, unsigned int const&);
+
+/* Two-pass version of query_case_table, which sizes the output exactly before writing it. Every mesh vertex is on a bipolar grid
+ * edge, and every grid edge is owned by its first vertex (edges along +x, +y, +z, in that order).
+ * Pass one: find the active cubes and their cases (see get_active_cells), then over the planes of vertices in parallel, count
+ * the triangles of each slab of cubes and the bipolar edges owned by each plane. Prefix sums over the counts give the first
+ * vertex of each plane and the first triangle of each slab in the output.
+ * Pass two: over ranges of slabs in parallel, number the bipolar edges of each plane in order, interpolating their vertices
+ * straight into the output, and write the triangles of every active cube from the numbers of its edges.
+ * Vertices are ordered by grid edge rather than by first use; triangles are in the same order as in query_case_table.
+ * The result is the same for any number of threads. */
+template<typename Scalar>
+IndexedMesh query_case_table_two_pass(VertexClassification const& grid_classification, std::vector<Scalar> const& grid_scalar_values,
+                                      GridDescriptor const& grid, float const& input_isovalue, unsigned int const& n_threads) {
+    IndexedMesh indexedMesh;
+    float isovalue = input_isovalue + 0.5;
+    std::cout << "Classifying all cubes in the grid (two pass)" << std::endl;
+
+    constexpr int CUBES_PER_CHUNK = 56; // A chunk of vertices along k needs one more vertex classification bit (57 max)
+    glm::ivec3 const& dims = grid.dims;
+    glm::ivec3 const cube_dims = dims - 1;
+    int const n_slabs = cube_dims.x;
+    std::size_t const plane_size = (std::size_t)dims.y * dims.z;
+
+    // Bipolar edges owned by the count (<= 56) vertices of row (i, j) from k on, one bit per vertex for each axis
+    auto get_bipolar_edges = [&](int i, int j, int k, unsigned int count, std::uint64_t (&bipolar)[3]) {
+        std::size_t first = grid.get_index(i, j, k);
+        bool has_next = k + (int)count < dims.z;
+        std::uint64_t mask = (std::uint64_t{1} << count) - 1;
+        std::uint64_t row = grid_classification.get_bits(first, count + has_next);
+        bipolar[0] = (i + 1 < dims.x) ? (row ^ grid_classification.get_bits(first + plane_size, count)) & mask : 0;
+        bipolar[1] = (j + 1 < dims.y) ? (row ^ grid_classification.get_bits(first + dims.z, count)) & mask : 0;
+        bipolar[2] = (row ^ (row >> 1)) & (has_next ? mask : mask >> 1);
     };
 
-     float isovalue = input_isovalue + 0.5; //TODO: Might be nicer to shift this elsewhere.
-    std::cout << "Classifying all cubes in the grid" << std::endl;
-    glm::vec3 extents = glm::abs(model_bbox.max - model_bbox.min);
-    float scale = 1.0f / grid_resolution;
+    //Pass one
+    ActiveCells const active = get_active_cells(grid_classification, grid, n_threads);
+    std::vector<std::size_t> first_vertex(dims.x + 1, 0), first_triangle(n_slabs + 1, 0);
+    parallel_for_slabs(dims.x, n_threads, [&](unsigned int plane) {
+        int const i = plane;
+        std::size_t n_vertices = 0;
+        for(int j = 0; j < dims.y; j++) {
+            for(int k = 0; k < dims.z; k += CUBES_PER_CHUNK) {
+                std::uint64_t bipolar[3];
+                get_bipolar_edges(i, j, k, std::min(CUBES_PER_CHUNK, dims.z - k), bipolar);
+                n_vertices += std::popcount(bipolar[0]) + std::popcount(bipolar[1]) + std::popcount(bipolar[2]);
+            }
+        }
+        first_vertex[i + 1] = n_vertices;
+        if(i == n_slabs) return;
+
+        std::size_t n_triangles = 0;
+        for(std::size_t cell = active.slab_begin[i]; cell < active.slab_begin[i + 1]; cell++) {
+            n_triangles += caseTable[active.cases[cell]].n_triangles;
+        }
+        first_triangle[i + 1] = n_triangles;
+    });
+    for(int i = 0; i < dims.x; i++) first_vertex[i + 1] += first_vertex[i];
+    for(int i = 0; i < n_slabs; i++) first_triangle[i + 1] += first_triangle[i];
+    indexedMesh.positions.resize(first_vertex[dims.x]);
+    indexedMesh.face_indices.resize(first_triangle[n_slabs] * 3);
+
+    //Pass two
+    unsigned int const n_ranges = (n_threads <= 1) ? 1 : std::min<unsigned int>(n_slabs, n_threads * 4);
+    parallel_for_slabs(n_ranges, n_threads, [&](unsigned int range) {
+        int const first_slab = (std::size_t)n_slabs * range / n_ranges;
+        int const last_slab = (std::size_t)n_slabs * (range + 1) / n_ranges;
+
+        // Vertex of each bipolar edge owned by planes i and i + 1: [(j * dims.z + k) * 3 + axis]. Other slots are not used
+        std::vector<unsigned int> planes[2] = {std::vector<unsigned int>(plane_size * 3), std::vector<unsigned int>(plane_size * 3)};
+        // Numbers the bipolar edges of plane i. Each plane's vertices are written by the range which starts at or contains it
+        auto number_plane = [&](int i, std::vector<unsigned int>& slots, bool write_positions) {
+            unsigned int vertex = first_vertex[i];
+            for(int j = 0; j < dims.y; j++) {
+                for(int k = 0; k < dims.z; k += CUBES_PER_CHUNK) {
+                    std::uint64_t bipolar[3];
+                    get_bipolar_edges(i, j, k, std::min(CUBES_PER_CHUNK, dims.z - k), bipolar);
+                    for(std::uint64_t bits = bipolar[0] | bipolar[1] | bipolar[2]; bits != 0; bits &= bits - 1) {
+                        int bit = std::countr_zero(bits);
+                        glm::ivec3 const ijk{i, j, k + bit};
+                        for(int axis = 0; axis < 3; axis++) {
+                            if(((bipolar[axis] >> bit) & 1u) == 0) continue;
+                            slots[((std::size_t)j * dims.z + k + bit) * 3 + axis] = vertex;
+                            if(write_positions) {
+                                glm::ivec3 other = ijk;
+                                other[axis]++;
+                                indexedMesh.positions[vertex] = linear_interpolation(grid.position(ijk), grid.position(other),
+                                                                                     grid_scalar_values[grid.get_index(ijk)],
+                                                                                     grid_scalar_values[grid.get_index(other)], isovalue);
+                            }
+                            vertex++;
+                        }
+                    }
+                }
+            }
+        };
+
+        number_plane(first_slab, planes[0], true);
+        for(int i = first_slab; i < last_slab; i++) {
+            if(i > first_slab) std::swap(planes[0], planes[1]);
+            number_plane(i + 1, planes[1], i + 1 < last_slab || i + 1 == n_slabs);
+
+            // Empty slabs at the end start one past the last face, so this cannot use &face_indices[...]
+            unsigned int* face_index = indexedMesh.face_indices.data() + first_triangle[i] * 3;
+            for(std::size_t cell = active.slab_begin[i]; cell < active.slab_begin[i + 1]; cell++) {
+                glm::ivec3 const& ijk = active.cells[cell];
+                CaseTableEntry const& case_entry = caseTable[active.cases[cell]];
+                unsigned int edge_vertices[12];
+                for(unsigned int n = 0; n < case_entry.n_edges; n++) {
+                    CubeEdge const& cube_edge = cube_edges[case_entry.edges[n]];
+                    std::size_t slot = ((std::size_t)(ijk.y + cube_edge.offset.y) * dims.z + ijk.z + cube_edge.offset.z) * 3 + cube_edge.axis;
+                    edge_vertices[n] = planes[cube_edge.offset.x][slot];
+                }
+                for(unsigned int n = 0; n < case_entry.n_triangles * 3u; n++) {
+                    *face_index++ = edge_vertices[case_entry.triangles[n]];
+                }
+            }
+        }
+    });
+    return indexedMesh;
+}
+
+template IndexedMesh query_case_table_two_pass<int>(VertexClassification const&, std::vector<int> const&, GridDescriptor const&,
+                                                    float const&, unsigned int const&);
+template IndexedMesh query_case_table_two_pass<std::uint16_t>(VertexClassification const&, std::vector<std::uint16_t> const&,
+                                                              GridDescriptor const&, float const&, unsigned int const&);
+template IndexedMesh query_case_table_two_pass<std::uint8_t>(VertexClassification const&, std::vector<std::uint8_t> const&,
+                                                             GridDescriptor const&, float const&, unsigned int const&);
+
+/* Same as query_case_table, but outputs the halfedge data structure, with the other halves and the outgoing halfedges already
+ * set, so the mesh can be remeshed straight away. The marching cubes lattice gives the adjacency:
+ * -----> Two triangles of the same cube share a mesh edge if they share its two vertices. These are paired once the cube is done.
+ * -----> Any other mesh edge has both ends on the same face of the cube (see cube_edge_faces), and its other half belongs to
+ *        the cube across that face. Cubes are visited in grid order, so the cube on the lower side of a face leaves its
+ *        halfedge in the face cache (see SlabFaceCache) and the cube on the upper side pairs with it.
+ * Slabs are extracted in order on one thread (finding the active cubes uses n_threads). Vertices and faces are the same as
+ * query_case_table, and the halfedges the same as building the HalfEdgeMesh from its output. */
+template<typename Scalar>
+HalfEdgeMesh query_case_table_halfedge(VertexClassification const& grid_classification, std::vector<Scalar> const& grid_scalar_values,
+                                       GridDescriptor const& grid, float const& input_isovalue, unsigned int const& n_threads) {
+    IndexedMesh indexedMesh;
+    HalfEdgeMesh mesh;
+    float isovalue = input_isovalue + 0.5;
+    std::cout << "Classifying all cubes in the grid (halfedge output)" << std::endl;
 
-    glm::ivec3 grid_boxes = {
-            extents.x / scale,
-            extents.y / scale,
-            extents.z / scale,
+    ActiveCells const active = get_active_cells(grid_classification, grid, n_threads);
+    int const n_slabs = grid.dims.x - 1;
+    SlabEdgeCache edge_cache(grid.dims, 0);
+    SlabFaceCache face_cache(grid.dims - 1);
+
+    auto vertex_from = [&](int halfedge) { return (int)indexedMesh.face_indices[halfedge]; };
+    auto pair_halves = [&](int halfedge, int other_half) {
+        mesh.halfedges_opposite[halfedge] = other_half;
+        mesh.halfedges_opposite[other_half] = halfedge;
     };
 
-    auto get_index = [grid_boxes](unsigned int i, unsigned int j, unsigned int k) -> unsigned int {
-        return i * (grid_boxes.y + 2) * (grid_boxes.z + 2) + j * (grid_boxes.z + 2) + k;
-    }; // note this will only work in a loop structured like the one below
-
-    for (unsigned int i = 0; i <= grid_boxes.x ; i++) {
-        for(unsigned int j = 0; j <= grid_boxes.y; j++) {
-            for(unsigned int k = 0; k <= grid_boxes.z; k++) {
-                //Get cube vertices
-                unsigned int vertex_values[8];
-                unsigned int vertex_idx[8];
-
-                vertex_idx[0] = get_index(i, j, k);
-                vertex_idx[1] = get_index(i, j+1, k);
-                vertex_idx[2] = get_index(i, j, k+1);
-                vertex_idx[3] = get_index(i, j+1, k+1);
-                vertex_idx[4] = get_index(i+1, j, k);
-                vertex_idx[5] = get_index(i+1, j+1, k);
-                vertex_idx[6] = get_index(i+1, j, k+1);
-                vertex_idx[7] = get_index(i+1, j+1, k+1);
-
-                vertex_values[0] = grid_classification[vertex_idx[0]];
-                vertex_values[1] = grid_classification[vertex_idx[1]];
-                vertex_values[2] = grid_classification[vertex_idx[2]];
-                vertex_values[3] = grid_classification[vertex_idx[3]];
-                vertex_values[4] = grid_classification[vertex_idx[4]];
-                vertex_values[5] = grid_classification[vertex_idx[5]];
-                vertex_values[6] = grid_classification[vertex_idx[6]];
-                vertex_values[7] = grid_classification[vertex_idx[7]];
-
-                unsigned int case_index = get_case(vertex_values);
-                int case_entry[17];
-                std::copy(std::begin(triangleTable[case_index]), std::end(triangleTable[case_index]), case_entry);
-                unsigned int triangle_n = case_entry[0]; //Number of triangles generated in this case
-                if(triangle_n == 0) continue; //Ignore cases which do not generate triangles - ie all positive or negative vertices
-
-                for(unsigned int triplet_count = 1; triplet_count < triangle_n*3; triplet_count += 3) {
-                    //Lookup edge vertices in table
-                    int triangle_edges[3] = {case_entry[triplet_count],
-                                             case_entry[triplet_count+1],
-                                             case_entry[triplet_count+2]}; // Columns 1-15 are broken into 5 triplets, each triplet representing
-                                                                        // 3 edges of a triangle which can be looked up in the edge table to find the vertices.
-                    // Get cube vertex indices
-                    int edge_0[2] =  {edgeTable[triangle_edges[0]][0], edgeTable[triangle_edges[0]][1] }; // An edge is described as the two vertices at the end
-                    int edge_1[2] =  {edgeTable[triangle_edges[1]][0], edgeTable[triangle_edges[1]][1] };
-                    int edge_2[2] =  {edgeTable[triangle_edges[2]][0], edgeTable[triangle_edges[2]][1] };
-
-                    //Interpolate edges to form a triangle
-                    unsigned int const& edge_0_vertex_0_idx = vertex_idx[edge_0[0]];
-                    unsigned int const& edge_0_vertex_1_idx = vertex_idx[edge_0[1]];
-
-                    unsigned int const& edge_1_vertex_0_idx = vertex_idx[edge_1[0]];
-                    unsigned int const& edge_1_vertex_1_idx = vertex_idx[edge_1[1]];
-
-                    unsigned int const& edge_2_vertex_0_idx = vertex_idx[edge_2[0]];
-                    unsigned int const& edge_2_vertex_1_idx = vertex_idx[edge_2[1]];
-
-                    glm::vec3 vertex_0 = linear_interpolation(grid_positions[edge_0_vertex_0_idx], grid_positions[edge_0_vertex_1_idx],
-                                         grid_scalar_values[edge_0_vertex_0_idx], grid_scalar_values[edge_0_vertex_1_idx], isovalue);
-
-                    glm::vec3 vertex_1 = linear_interpolation(grid_positions[edge_1_vertex_0_idx], grid_positions[edge_1_vertex_1_idx],
-                                                              grid_scalar_values[edge_1_vertex_0_idx], grid_scalar_values[edge_1_vertex_1_idx], isovalue);
-
-                    glm::vec3 vertex_2 = linear_interpolation(grid_positions[edge_2_vertex_0_idx], grid_positions[edge_2_vertex_1_idx],
-                                                              grid_scalar_values[edge_2_vertex_0_idx], grid_scalar_values[edge_2_vertex_1_idx],  isovalue);
-
-                    //TODO: check if vertex already exists. This will remove duplicate vertices.
-                    //TODO: return indexed mesh.
-                    //The idea is to maybe index these vertices so they are not duplicated.
-
-                    unsigned int idx_0 = set_vertex(vertex_0);
-                    unsigned int idx_1 = set_vertex(vertex_1);
-                    unsigned int idx_2 = set_vertex(vertex_2);
-                    indexedMesh.face_indices.push_back(idx_0);
-                    indexedMesh.face_indices.push_back(idx_1);
-                    indexedMesh.face_indices.push_back(idx_2);
-//                    reconstructed_mesh.push_back(vertex_0);
-//                    reconstructed_mesh.push_back(vertex_1);
-//                    reconstructed_mesh.push_back(vertex_2);
+    for(int i = 0; i < n_slabs; i++) {
+        if(i > 0) {
+            edge_cache.next_slab();
+            face_cache.next_slab();
+        }
+        for(std::size_t cell = active.slab_begin[i]; cell < active.slab_begin[i + 1]; cell++) {
+            glm::ivec3 const& ijk = active.cells[cell];
+            glm::vec3 vertex_positions[8];
+            int vertex_scalars[8];
+            for(unsigned int n = 0; n < 8; n++) {
+                vertex_positions[n] = grid.position(ijk + cube_offsets[n]);
+                vertex_scalars[n] = grid_scalar_values[grid.get_index(ijk + cube_offsets[n])];
+            }
+            auto edge_slot = [&](int edge) -> int& {
+                CubeEdge const& cube_edge = cube_edges[edge];
+                return edge_cache.get_slot(cube_edge.offset.x, ijk.y + cube_edge.offset.y, ijk.z + cube_edge.offset.z, cube_edge.axis);
+            };
+            int const first_halfedge = indexedMesh.face_indices.size();
+            march_cube(active.cases[cell], vertex_positions, vertex_scalars, isovalue, indexedMesh, edge_slot);
+            int const last_halfedge = indexedMesh.face_indices.size();
+
+            // Halfedge n of a face goes from its vertex n to vertex n + 1
+            mesh.vertex_outgoing_halfedge.resize(indexedMesh.positions.size(), -1);
+            for(int halfedge = first_halfedge; halfedge < last_halfedge; halfedge++) {
+                int face_start = halfedge - halfedge % 3;
+                mesh.halfedges_vertex_to.push_back(indexedMesh.face_indices[face_start + (halfedge + 1) % 3]);
+                mesh.halfedges_opposite.push_back(-1);
+                mesh.vertex_outgoing_halfedge[vertex_from(halfedge)] = halfedge;
+            }
+
+            CaseTableEntry const& case_entry = caseTable[active.cases[cell]];
+            auto get_cube_edge = [&](int vertex) {
+                unsigned int n = 0;
+                while(edge_slot(case_entry.edges[n]) != vertex) n++;
+                return case_entry.edges[n];
+            };
+            for(int halfedge = first_halfedge; halfedge < last_halfedge; halfedge++) {
+                if(mesh.halfedges_opposite[halfedge] != -1) continue;
+                int const from = vertex_from(halfedge);
+                int const to = mesh.halfedges_vertex_to[halfedge];
 
+                // Other half in the same cube
+                int other_half = halfedge + 1;
+                while(other_half < last_halfedge && (vertex_from(other_half) != to || mesh.halfedges_vertex_to[other_half] != from)) {
+                    other_half++;
+                }
+                if(other_half < last_halfedge) {
+                    pair_halves(halfedge, other_half);
+                    continue;
                 }
 
+                // Other half across the cube face both ends are on
+                unsigned int faces = cube_edge_faces[get_cube_edge(from)] & cube_edge_faces[get_cube_edge(to)];
+                if(faces == 0) continue;
+                int const face = std::countr_zero(faces);
+                std::array<int, 2>* face_halfedges = face_cache.get_face(ijk, face);
+                if(face_halfedges == nullptr) continue; // Border of the grid, the mesh is open here
+                for(int& waiting : *face_halfedges) {
+                    if(face % 2 == 1) {
+                        if(waiting != -1) continue;
+                        waiting = halfedge;
+                        break;
+                    }
+                    if(waiting != -1 && vertex_from(waiting) == to && mesh.halfedges_vertex_to[waiting] == from) {
+                        pair_halves(halfedge, waiting);
+                        waiting = -1;
+                        break;
+                    }
+                }
             }
         }
     }
+
+    mesh.vertex_positions = std::move(indexedMesh.positions);
+    mesh.faces = std::move(indexedMesh.face_indices);
+    return mesh;
+}
+
+template HalfEdgeMesh query_case_table_halfedge<int>(VertexClassification const&, std::vector<int> const&, GridDescriptor const&,
+                                                     float const&, unsigned int const&);
+template HalfEdgeMesh query_case_table_halfedge<std::uint16_t>(VertexClassification const&, std::vector<std::uint16_t> const&,
+                                                               GridDescriptor const&, float const&, unsigned int const&);
+template HalfEdgeMesh query_case_table_halfedge<std::uint8_t>(VertexClassification const&, std::vector<std::uint8_t> const&,
+                                                              GridDescriptor const&, float const&, unsigned int const&);
+
+namespace {
+    std::size_t get_block_index(BlockMeshStore const& store, glm::ivec3 const& block_ijk) {
+        return ((std::size_t)block_ijk.x * store.block_dims.y + block_ijk.y) * store.block_dims.z + block_ijk.z;
+    }
+
+    // Corners hold the offset (0 or 1 along each axis) of the block owning their grid edge in their top 3 bits
+    constexpr int OWNER_SHIFT = 61;
+    constexpr std::uint64_t GRID_EDGE_MASK = (std::uint64_t{1} << OWNER_SHIFT) - 1;
+
+    /* Writes the triangles of the active cubes of the block. Rows of cubes along k are classified from the rows of vertex
+     * classification they touch (see get_case), and rows with no bipolar edge are skipped like in get_active_cells.
+     * A grid edge is owned by the block of the cube its first vertex is the min corner of. Edges on the upper border of the
+     * grid have no such cube, and are owned by the block of the cube below them along the other axes. */
+    void march_block(BlockMeshStore& store, glm::ivec3 const& block_ijk) {
+        GridDescriptor const& grid = store.grid;
+        MeshBlock& block = store.blocks[get_block_index(store, block_ijk)];
+        block.corners.clear();
+        block.vertices.clear();
+
+        glm::ivec3 const first_cube = block_ijk * MESH_BLOCK_SIZE;
+        glm::ivec3 const last_cube = glm::min(first_cube + MESH_BLOCK_SIZE, grid.dims - 1);
+        // Vertices at the end of the block along an axis are owned by the next block, unless it is the end of the grid
+        glm::ivec3 const next_block_vertex = glm::ivec3(glm::lessThan(last_cube, grid.dims - 1)) * last_cube +
+                                             glm::ivec3(glm::equal(last_cube, grid.dims - 1)) * (grid.dims + 1);
+        unsigned int const row_length = last_cube.z - first_cube.z;
+        std::uint64_t const row_mask = (std::uint64_t{1} << row_length) - 1;
+        for(int i = first_cube.x; i < last_cube.x; i++) {
+            for(int j = first_cube.y; j < last_cube.y; j++) {
+                std::uint64_t rows[4] = {store.classification.get_bits(grid.get_index(i, j, first_cube.z), row_length + 1),
+                                         store.classification.get_bits(grid.get_index(i, j + 1, first_cube.z), row_length + 1),
+                                         store.classification.get_bits(grid.get_index(i + 1, j, first_cube.z), row_length + 1),
+                                         store.classification.get_bits(grid.get_index(i + 1, j + 1, first_cube.z), row_length + 1)};
+                std::uint64_t any_positive = 0, all_positive = ~std::uint64_t{0};
+                for(auto const& row : rows) {
+                    any_positive |= row | (row >> 1);
+                    all_positive &= row & (row >> 1);
+                }
+                for(std::uint64_t mixed = any_positive & ~all_positive & row_mask; mixed != 0; mixed &= mixed - 1) {
+                    unsigned int cube = std::countr_zero(mixed);
+                    CaseTableEntry const& case_entry = caseTable[get_case((rows[0] >> cube) & 3u, (rows[1] >> cube) & 3u,
+                                                                          (rows[2] >> cube) & 3u, (rows[3] >> cube) & 3u)];
+                    glm::ivec3 const ijk{i, j, first_cube.z + (int)cube};
+                    std::uint64_t corner_values[12];
+                    for(unsigned int n = 0; n < case_entry.n_edges; n++) {
+                        CubeEdge const& cube_edge = cube_edges[case_entry.edges[n]];
+                        glm::ivec3 const first_vertex = ijk + cube_edge.offset;
+                        std::uint64_t edge = grid.get_index(first_vertex) * 3 + cube_edge.axis;
+                        glm::bvec3 const next_owner = glm::equal(first_vertex, next_block_vertex);
+                        std::uint64_t owner = next_owner.x * 4u + next_owner.y * 2u + next_owner.z;
+                        if(owner == 0) block.vertices.push_back(edge);
+                        corner_values[n] = edge | (owner << OWNER_SHIFT);
+                    }
+                    for(unsigned int n = 0; n < case_entry.n_triangles * 3u; n++) {
+                        block.corners.push_back(corner_values[case_entry.triangles[n]]);
+                    }
+                }
+            }
+        }
+        std::sort(block.vertices.begin(), block.vertices.end());
+        block.vertices.erase(std::unique(block.vertices.begin(), block.vertices.end()), block.vertices.end());
+    }
+
+    void march_blocks(BlockMeshStore& store, std::vector<glm::ivec3> const& block_list, unsigned int const& n_threads) {
+        parallel_for_slabs(block_list.size(), n_threads, [&](unsigned int block) {
+            march_block(store, block_list[block]);
+        });
+    }
+}
+
+/* Every block writes its own triangles, so blocks are marched in parallel. Each mesh vertex (bipolar grid edge) is listed by
+ * the one block which owns it, so the vertices can be numbered block by block without a global sort. */
+BlockMeshStore create_block_mesh_store(VertexClassification const& grid_values, GridDescriptor const& grid, int const& isovalue,
+                                       unsigned int const& n_threads) {
+    std::cout << "Creating block mesh store" << std::endl;
+    BlockMeshStore store;
+    store.grid = grid;
+    store.isovalue = isovalue;
+    store.classification = grid_values;
+    store.block_dims = (glm::max(grid.dims - 1, glm::ivec3(0)) + MESH_BLOCK_SIZE - 1) / MESH_BLOCK_SIZE;
+    store.blocks.resize((std::size_t)store.block_dims.x * store.block_dims.y * store.block_dims.z);
+
+    std::vector<glm::ivec3> block_list;
+    block_list.reserve(store.blocks.size());
+    for(int i = 0; i < store.block_dims.x; i++) {
+        for(int j = 0; j < store.block_dims.y; j++) {
+            for(int k = 0; k < store.block_dims.z; k++) {
+                block_list.emplace_back(i, j, k);
+            }
+        }
+    }
+    march_blocks(store, block_list, n_threads);
+    return store;
+}
+
+/* The case index of a cube only changes if the classification of one of its corners does, so the vertices which changed class
+ * are the set bits of the XOR of the old and new classification words. The changed bits of a word are taken one row of
+ * vertices along k at a time, and every block with a cube around them is marched again. Small isovalue steps only flip the
+ * shell of vertices between the two isosurfaces. */
+std::size_t update_isovalue(BlockMeshStore& store, VertexClassification const& grid_values, int const& isovalue,
+                            unsigned int const& n_threads) {
+    GridDescriptor const& grid = store.grid;
+    glm::ivec3 const cube_dims = grid.dims - 1;
+    std::vector<std::uint8_t> dirty(store.blocks.size(), 0);
+    for(std::size_t word = 0; word < grid_values.words.size(); word++) {
+        std::uint64_t changed = grid_values.words[word] ^ store.classification.words[word];
+        while(changed != 0) {
+            std::size_t const first_vertex = word * 64 + std::countr_zero(changed);
+            std::size_t const row = first_vertex / grid.dims.z;
+            std::size_t const row_end = (row + 1) * grid.dims.z - word * 64; // First bit of the next row, may be past the word
+            std::uint64_t const in_row = (row_end >= 64) ? changed : changed & ((std::uint64_t{1} << row_end) - 1);
+            changed &= ~in_row;
+
+            // Cubes (i - 1, j - 1) to (i, j) along k from the first changed vertex - 1 to the last one have them as corners
+            glm::ivec3 const first{(int)(row / grid.dims.y), (int)(row % grid.dims.y), (int)(first_vertex - row * grid.dims.z)};
+            glm::ivec3 const last{first.x, first.y, (int)(word * 64 + 63 - std::countl_zero(in_row) - row * grid.dims.z)};
+            glm::ivec3 const first_block = glm::max(first - 1, glm::ivec3(0)) / MESH_BLOCK_SIZE;
+            glm::ivec3 const last_block = glm::min(last, cube_dims - 1) / MESH_BLOCK_SIZE;
+            for(int i = first_block.x; i <= last_block.x; i++) {
+                for(int j = first_block.y; j <= last_block.y; j++) {
+                    for(int k = first_block.z; k <= last_block.z; k++) {
+                        dirty[get_block_index(store, {i, j, k})] = 1;
+                    }
+                }
+            }
+        }
+    }
+    store.classification = grid_values;
+    store.isovalue = isovalue;
+
+    std::vector<glm::ivec3> block_list;
+    for(int i = 0; i < store.block_dims.x; i++) {
+        for(int j = 0; j < store.block_dims.y; j++) {
+            for(int k = 0; k < store.block_dims.z; k++) {
+                if(dirty[get_block_index(store, {i, j, k})]) block_list.emplace_back(i, j, k);
+            }
+        }
+    }
+    std::cout << "Marching " << block_list.size() << " of " << store.blocks.size() << " blocks for isovalue " << isovalue << std::endl;
+    march_blocks(store, block_list, n_threads);
+    return block_list.size();
+}
+
+/* Prefix sums over the blocks give the first vertex and triangle of each block in the output. Slabs of blocks are then
+ * written in parallel: the vertices each block owns are interpolated at the isovalue, and each triangle corner is looked up
+ * in the sorted vertices of the block owning its grid edge. */
+template<typename Scalar>
+IndexedMesh query_case_table(BlockMeshStore const& store, std::vector<Scalar> const& grid_scalar_values, unsigned int const& n_threads) {
+    IndexedMesh indexedMesh;
+    GridDescriptor const& grid = store.grid;
+    float isovalue = store.isovalue + 0.5;
+
+    std::vector<std::size_t> first_vertex(store.blocks.size() + 1, 0), first_corner(store.blocks.size() + 1, 0);
+    for(std::size_t block = 0; block < store.blocks.size(); block++) {
+        first_vertex[block + 1] = first_vertex[block] + store.blocks[block].vertices.size();
+        first_corner[block + 1] = first_corner[block] + store.blocks[block].corners.size();
+    }
+    indexedMesh.positions.resize(first_vertex.back());
+    indexedMesh.face_indices.resize(first_corner.back());
+
+    parallel_for_slabs(store.block_dims.x, n_threads, [&](unsigned int slab) {
+        for(int j = 0; j < store.block_dims.y; j++) {
+            for(int k = 0; k < store.block_dims.z; k++) {
+                glm::ivec3 const block_ijk{(int)slab, j, k};
+                std::size_t const block = get_block_index(store, block_ijk);
+                MeshBlock const& mesh_block = store.blocks[block];
+                for(std::size_t n = 0; n < mesh_block.vertices.size(); n++) {
+                    glm::ivec3 const ijk = grid.get_ijk(mesh_block.vertices[n] / 3);
+                    glm::ivec3 other = ijk;
+                    other[mesh_block.vertices[n] % 3]++;
+                    indexedMesh.positions[first_vertex[block] + n] = linear_interpolation(grid.position(ijk), grid.position(other),
+                                                                                          grid_scalar_values[grid.get_index(ijk)],
+                                                                                          grid_scalar_values[grid.get_index(other)], isovalue);
+                }
+                for(std::size_t n = 0; n < mesh_block.corners.size(); n++) {
+                    std::uint64_t const edge = mesh_block.corners[n] & GRID_EDGE_MASK;
+                    unsigned int const owner_offset = mesh_block.corners[n] >> OWNER_SHIFT;
+                    std::size_t const owner = get_block_index(store, block_ijk + glm::ivec3(owner_offset >> 2, (owner_offset >> 1) & 1u,
+                                                                                            owner_offset & 1u));
+                    std::vector<std::uint64_t> const& owned = store.blocks[owner].vertices;
+                    indexedMesh.face_indices[first_corner[block] + n] =
+                            first_vertex[owner] + (std::lower_bound(owned.begin(), owned.end(), edge) - owned.begin());
+                }
+            }
+        }
+    });
     return indexedMesh;
+}
+
+template IndexedMesh query_case_table<int>(BlockMeshStore const&, std::vector<int> const&, unsigned int const&);
+template IndexedMesh query_case_table<std::uint16_t>(BlockMeshStore const&, std::vector<std::uint16_t> const&, unsigned int const&);
+template IndexedMesh query_case_table<std::uint8_t>(BlockMeshStore const&, std::vector<std::uint8_t> const&, unsigned int const&);
+
+/* Same as above, on the sparse grid. Cubes are visited block by block, each cube belonging to the block of its first vertex.
+ * Corners in blocks that were not allocated are positive with the grid's background value. Cubes outside the band have no
+ * negative corners, so they are skipped with their block. */
+IndexedMesh query_case_table(SparseGrid const& grid, float const& input_isovalue) {
+    IndexedMesh indexedMesh;
+    float isovalue = input_isovalue + 0.5;
+    std::cout << "Classifying all cubes in the sparse grid" << std::endl;
 
+    // Index of the mesh vertex on the edges starting at each allocated vertex: [(block * SPARSE_BLOCK_VOLUME + vertex) * 3 + axis].
+    // Every corner of a cube with a negative corner is allocated (see create_sparse_grid), so all edges producing vertices are here
+    std::vector<int> edge_vertices(grid.blocks.size() * SPARSE_BLOCK_VOLUME * 3, -1);
+
+    for(auto const& block : grid.blocks) {
+        // Blocks the cubes of this block can reach into: [1][1][1] is the next block along all three axes
+        SparseBlock const* neighbours[2][2][2];
+        glm::ivec3 block_ijk = block.origin / SPARSE_BLOCK_SIZE;
+        for(int di = 0; di < 2; di++) {
+            for(int dj = 0; dj < 2; dj++) {
+                for(int dk = 0; dk < 2; dk++) {
+                    neighbours[di][dj][dk] = (di + dj + dk == 0) ? &block : grid.find_block(block_ijk + glm::ivec3{di, dj, dk});
+                }
+            }
+        }
+
+        // There are dims - 1 cubes along each axis
+        glm::ivec3 cubes = glm::min(glm::ivec3(SPARSE_BLOCK_SIZE), grid.descriptor.dims - 1 - block.origin);
+        for(int i = 0; i < cubes.x; i++) {
+            for(int j = 0; j < cubes.y; j++) {
+                for(int k = 0; k < cubes.z; k++) {
+                    unsigned int vertex_values[8];
+                    int vertex_scalars[8];
+                    for(unsigned int n = 0; n < 8; n++) {
+                        glm::ivec3 local = glm::ivec3{i, j, k} + cube_offsets[n];
+                        glm::ivec3 neighbour = local / SPARSE_BLOCK_SIZE;
+                        SparseBlock const* corner_block = neighbours[neighbour.x][neighbour.y][neighbour.z];
+                        if(corner_block == nullptr) {
+                            vertex_values[n] = 1;
+                            vertex_scalars[n] = grid.background_value;
+                        } else {
+                            int vertex = SparseBlock::local_index(local % SPARSE_BLOCK_SIZE);
+                            vertex_values[n] = corner_block->get_classification(vertex);
+                            vertex_scalars[n] = corner_block->scalar_values[vertex];
+                        }
+                    }
+
+                    unsigned int case_index = get_case(vertex_values);
+                    if(caseTable[case_index].n_triangles == 0) continue;
+
+                    glm::vec3 vertex_positions[8];
+                    for(unsigned int n = 0; n < 8; n++) {
+                        vertex_positions[n] = grid.position(block.origin + glm::ivec3{i, j, k} + cube_offsets[n]);
+                    }
+                    march_cube(case_index, vertex_positions, vertex_scalars, isovalue, indexedMesh, [&](int edge) -> int& {
+                        glm::ivec3 local = glm::ivec3{i, j, k} + cube_edges[edge].offset;
+                        glm::ivec3 neighbour = local / SPARSE_BLOCK_SIZE;
+                        std::size_t block_idx = neighbours[neighbour.x][neighbour.y][neighbour.z] - grid.blocks.data();
+                        std::size_t vertex = block_idx * SPARSE_BLOCK_VOLUME + SparseBlock::local_index(local % SPARSE_BLOCK_SIZE);
+                        return edge_vertices[vertex * 3 + cube_edges[edge].axis];
+                    });
+                }
+            }
+        }
+    }
+    return indexedMesh;
 }
 
 #if TEST_MODE == ON
@@ -6,19 +6,92 @@
 #define MARCHING_CUBES_POINT_CLOUD_SURFACE_RECONSTRUCTION_HPP
 
 #include <vector>
+#include <cstdint>
+#include <cstddef>
 #include <glm/vec3.hpp>
 #include <glm/glm.hpp>
 #include <iostream>
 #include "distance_field.hpp"
+#include "sparse_grid.hpp"
 #include "../render/cw1/mesh.hpp"
 
 unsigned int get_case(unsigned int const (&vertex_values)[8]);
 
+// Same as above, from the 2 bit rows of vertex classification along k (see surface_reconstruction.cpp)
+unsigned int get_case(unsigned int const& row_00, unsigned int const& row_01, unsigned int const& row_10, unsigned int const& row_11);
+
 glm::vec3 linear_interpolation(glm::vec3 const& point_1, glm::vec3 const& point_2,
                                unsigned int const& scalar_1, unsigned int const& scalar_2, float const& isovalue);
 
-IndexedMesh query_case_table(std::vector<unsigned int> const& grid_values, std::vector<glm::vec3> const& grid_positions,
-                                        std::vector<int> const& grid_scalar_values, float const& grid_resolution, BoundingBox const& model_bbox, float const& input_isovalue);
+// Cubes with a bipolar edge (the only cubes which produce triangles), in grid order
+struct ActiveCells {
+    std::vector<glm::ivec3> cells;       // Grid coordinates of the first vertex of each cube
+    std::vector<std::uint8_t> cases;     // Case index of each cube
+    std::vector<std::size_t> slab_begin; // Cubes of i-slab s are [slab_begin[s], slab_begin[s + 1])
+};
+
+// Finds the active cubes from the vertex classification, 56 cubes at a time, over the i-slabs on n_threads threads
+ActiveCells get_active_cells(VertexClassification const& grid_values, GridDescriptor const& grid, unsigned int const& n_threads = 1);
+
+// Extracts the i-slabs of cubes on n_threads threads; the mesh is the same for any number of threads.
+// Instantiated for the scalar field types in scalar_field.hpp
+template<typename Scalar>
+IndexedMesh query_case_table(VertexClassification const& grid_values, std::vector<Scalar> const& grid_scalar_values,
+                             GridDescriptor const& grid, float const& input_isovalue, unsigned int const& n_threads = 1);
+
+// Same as above, for several isovalues in a single pass over the scalar field, which shares the corner loads and the case
+// indices. Returns the mesh of each isovalue, in the order given, the same as from query_case_table
+template<typename Scalar>
+std::vector<IndexedMesh> query_case_table_batch(std::vector<Scalar> const& grid_scalar_values, GridDescriptor const& grid,
+                                                std::vector<int> const& input_isovalues, unsigned int const& n_threads = 1);
+
+// Same as above, but counts the vertices and triangles first so they are written straight into exactly sized arrays.
+// Gives the same triangles, with the vertices numbered in grid edge order
+template<typename Scalar>
+IndexedMesh query_case_table_two_pass(VertexClassification const& grid_values, std::vector<Scalar> const& grid_scalar_values,
+                                      GridDescriptor const& grid, float const& input_isovalue, unsigned int const& n_threads = 1);
+
+// Same as query_case_table, but outputs the halfedge data structure with the other halves paired while the triangles are
+// created, so it is ready to remesh
+template<typename Scalar>
+HalfEdgeMesh query_case_table_halfedge(VertexClassification const& grid_values, std::vector<Scalar> const& grid_scalar_values,
+                                       GridDescriptor const& grid, float const& input_isovalue, unsigned int const& n_threads = 1);
+
+constexpr int MESH_BLOCK_SIZE = 8; // Cubes along each axis of a block of the BlockMeshStore
+
+// Triangles of the active cubes of a block, stored as the grid edges their corners are on (first vertex index * 3 + axis)
+struct MeshBlock {
+    std::vector<std::uint64_t> corners;  // 3 per triangle, in the order of the case table
+    std::vector<std::uint64_t> vertices; // Grid edges of the corners owned by this block, sorted (see create_block_mesh_store)
+};
+
+// Marching cubes surface of a dense grid, kept per block of 8x8x8 cubes. Only the topology is stored, since the vertex
+// positions depend on the isovalue: the surface at another isovalue of the same scalar field only needs the blocks with a
+// cube whose case index changed to be marched again
+struct BlockMeshStore {
+    GridDescriptor grid;
+    int isovalue = 0;
+    VertexClassification classification; // Grid vertex classification at isovalue
+    glm::ivec3 block_dims{0};            // Number of blocks along each axis
+    std::vector<MeshBlock> blocks;       // Laid out like the grid
+};
+
+// Marches every block of the grid, on n_threads threads
+BlockMeshStore create_block_mesh_store(VertexClassification const& grid_values, GridDescriptor const& grid, int const& isovalue,
+                                       unsigned int const& n_threads = 1);
+
+// Moves the store to the classification of the same grid at a new isovalue, marching again only the blocks with a cube that
+// has a vertex whose classification changed. Returns the number of blocks marched
+std::size_t update_isovalue(BlockMeshStore& store, VertexClassification const& grid_values, int const& isovalue,
+                            unsigned int const& n_threads = 1);
+
+// Same as query_case_table, from the triangles in the block mesh store. The vertices are interpolated at the store's isovalue,
+// numbered block by block
+template<typename Scalar>
+IndexedMesh query_case_table(BlockMeshStore const& store, std::vector<Scalar> const& grid_scalar_values, unsigned int const& n_threads = 1);
+
+// Same as query_case_table, on the band of blocks allocated in the sparse grid
+IndexedMesh query_case_table(SparseGrid const& grid, float const& input_isovalue);
 
 std::vector<glm::vec3> query_case_table_test(std::vector<unsigned int> const& grid_values, std::vector<glm::vec3> const& grid_positions,
                                              float const& input_isovalue);
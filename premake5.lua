@@ -157,6 +157,23 @@ project "incremental_remeshing"
 
 	files( sources )
 
+project "tests"
+	local sources = {
+		"tests/**.cpp",
+		"tests/**.hpp",
+		"tests/**.hxx"
+	}
+
+	kind "ConsoleApp"
+	location "tests"
+
+	files( sources )
+
+	links "marching-cubes"
+	links "incremental_remeshing"
+
+	dependson "x-glm"
+
 
 
 --EOF
\ No newline at end of file
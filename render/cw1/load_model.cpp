@@ -250,8 +250,33 @@ void read_config(const std::string& filename, UiConfiguration& config) {
             else if (key == "padding") iss >> config.padding;
             else if (key == "point_cloud_size") iss >> config.point_cloud_size;
             else if (key == "isovalue") iss >> config.isovalue;
+            else if (key == "distance_field_engine") {
+                std::string engine;
+                iss >> engine;
+                if (engine == "brute_force") config.distance_field_engine = DistanceFieldEngine::brute_force;
+                else if (engine == "kd_tree") config.distance_field_engine = DistanceFieldEngine::kd_tree;
+                else if (engine == "distance_transform") config.distance_field_engine = DistanceFieldEngine::distance_transform;
+                else if (engine == "classify_first") config.distance_field_engine = DistanceFieldEngine::classify_first;
+                else if (engine == "coarse_to_fine") config.distance_field_engine = DistanceFieldEngine::coarse_to_fine;
+                else std::cerr << "Unknown distance_field_engine " << engine << ", using kd_tree" << std::endl;
+            }
+            else if (key == "n_threads") iss >> config.n_threads;
+            else if (key == "sparse_grid") iss >> config.sparse_grid;
+            else if (key == "two_pass_extraction") iss >> config.two_pass_extraction;
+            else if (key == "halfedge_extraction") iss >> config.halfedge_extraction;
+            else if (key == "write_obj") iss >> config.write_obj;
+            else if (key == "scalar_field_type") {
+                std::string type;
+                iss >> type;
+                if (type == "int32") config.scalar_field_type = ScalarFieldType::int32;
+                else if (type == "uint16") config.scalar_field_type = ScalarFieldType::uint16;
+                else if (type == "uint8") config.scalar_field_type = ScalarFieldType::uint8;
+                else std::cerr << "Unknown scalar_field_type " << type << ", using int32" << std::endl;
+            }
             else if (key == "target_edge_length") iss >> config.target_edge_length;
             else if (key == "remeshing_iterations") iss >> config.remeshing_iterations;
+            else if (key == "priority_queue_remeshing") iss >> config.priority_queue_remeshing;
+            else if (key == "jacobi_relaxation") iss >> config.jacobi_relaxation;
         }
     }
 
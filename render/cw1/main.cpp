@@ -62,6 +62,8 @@ namespace lut = labutils;
 #include "mesh.hpp"
 #include "../../marching_cubes/surface_reconstruction.hpp"
 #include "../../marching_cubes/distance_field.hpp"
+#include "../../marching_cubes/sparse_grid.hpp"
+#include "../../marching_cubes/parallel.hpp"
 #include "../../marching_cubes_test/test_scene.hpp"
 #include "../../incremental_remeshing/halfedge.hpp"
 
@@ -275,6 +277,9 @@ int main(int argc, char* argv[]) try
     BoundingBox pointCloudBBox = get_bounding_box(pointCloud.positions);
     //TODO: set camera centre as centre of point cloud.
 
+    // Nearest neighbour search structure. Only depends on the point cloud, so it is built once per load.
+    KDTree pointCloudTree(pointCloud.positions);
+
 #pragma region "Marching Cubes"
     PointCloud distanceField; //(grid)
     std::vector<uint32_t> grid_edges; // An edge is the indices of its two vertices in the grid_positions array
@@ -284,16 +289,29 @@ int main(int argc, char* argv[]) try
 
     //Create grid
     auto start = std::chrono::high_resolution_clock::now();
-    distanceField.positions = create_regular_grid(ui_config.grid_resolution, grid_edges, pointCloudBBox);
-    distanceField.point_size = calculate_distance_field(distanceField.positions, pointCloud.positions);
-    std::vector<unsigned int> vertex_classification = classify_grid_vertices(distanceField.point_size, ui_config.isovalue);
+    GridDescriptor grid;
+    SparseGrid sparseGrid;
+    VertexClassification vertex_classification;
+    ScalarField scalarField; // Scalar values at the grid vertices (or the active vertices of the sparse grid)
+    if(ui_config.sparse_grid) {
+        sparseGrid = create_sparse_grid(pointCloud.positions, get_grid_descriptor(ui_config.grid_resolution, pointCloudBBox), ui_config.isovalue);
+        calculate_distance_field(sparseGrid, pointCloudTree, resolve_thread_count(ui_config.n_threads));
+        classify_grid_vertices(sparseGrid, ui_config.isovalue);
+        std::vector<int> active_scalar_values;
+        get_active_vertices(sparseGrid, distanceField.positions, active_scalar_values, vertex_classification);
+        scalarField = std::move(active_scalar_values);
+    } else {
+        grid = create_regular_grid(ui_config.grid_resolution, grid_edges, pointCloudBBox);
+        scalarField = evaluate_distance_field(ui_config.scalar_field_type, ui_config.distance_field_engine, grid, pointCloud.positions,
+                                              pointCloudTree, ui_config.isovalue, ui_config.n_threads);
+        vertex_classification = std::visit([&](auto const& scalar_values) {
+            return classify_grid_vertices(scalar_values, ui_config.isovalue);
+        }, scalarField);
+    }
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed{end-start};
     int min = static_cast<int>(elapsed.count() / 60);
     std::cout << "Time taken to create & classify distance field : " << min << "m " << elapsed.count() - (min*60) << "s " << std::endl;
-    distanceField.set_color(vertex_classification);
-
-    auto [edge_values, edge_colors] = classify_grid_edges(vertex_classification, pointCloudBBox, ui_config.grid_resolution);
 
     //Buffers for rendering
     std::vector<MeshBuffer> mBuffer;
@@ -302,8 +320,9 @@ int main(int argc, char* argv[]) try
 
     //Create marching cubes surface
     start = std::chrono::high_resolution_clock::now();
-    IndexedMesh reconstructedSurfaceIndexed = query_case_table(vertex_classification, distanceField.positions, distanceField.point_size, ui_config.grid_resolution,
-                                                      pointCloudBBox, ui_config.isovalue);
+    HalfEdgeMesh marchingCubesMesh;
+    IndexedMesh reconstructedSurfaceIndexed = extract_surface(ui_config, sparseGrid, grid, vertex_classification, scalarField,
+                                                              marchingCubesMesh);
     end = std::chrono::high_resolution_clock::now();
     elapsed = end-start;
     min = static_cast<int>(elapsed.count() / 60);
@@ -312,9 +331,7 @@ int main(int argc, char* argv[]) try
     reconstructedSurface.set_color(glm::vec3{1.0f, 0.0f, 0.0f});
     reconstructedSurface.set_normals(glm::vec3(1.0f,1.0,0));
 
-    //Create file and convert to HalfEdge data structure
-    write_OBJ(reconstructedSurfaceIndexed, cfg::MC_obj_name);
-    HalfEdgeMesh marchingCubesMesh = obj_to_halfedge(cfg::MC_obj_name);
+    if(ui_config.write_obj) write_OBJ(reconstructedSurfaceIndexed, cfg::MC_obj_name);
     ui_config.mc_manifold = marchingCubesMesh.check_manifold();
     if(!ui_config.mc_manifold) {
         std::cerr << "Reconstructed Surface is not manifold (the mesh has a boundary) - increment padding " << std::endl;
@@ -338,13 +355,14 @@ int main(int argc, char* argv[]) try
     HalfEdgeMesh remeshedMesh = marchingCubesMesh;
     ui_config.target_edge_length = remeshedMesh.get_mean_edge_length(); //TODO: remove this?
     start = std::chrono::high_resolution_clock::now();
-    remeshedMesh.remesh(ui_config.target_edge_length, ui_config.remeshing_iterations);
+    remeshedMesh.remesh(ui_config.target_edge_length, ui_config.remeshing_iterations, ui_config.priority_queue_remeshing,
+                        ui_config.jacobi_relaxation, resolve_thread_count(ui_config.n_threads));
     end = std::chrono::high_resolution_clock::now();
     elapsed = end-start;
     min = static_cast<int>(elapsed.count() / 60);
     std::cout << "Time taken to remesh : " << min << "m " << elapsed.count() - (min*60) << "s " << std::endl;
 
-    write_OBJ(remeshedMesh, cfg::remeshed_obj_name);
+    if(ui_config.write_obj) write_OBJ(remeshedMesh, cfg::remeshed_obj_name);
 
     if(!reconstructedSurface.positions.empty()) { // Do not create an empty buffer - this will produce an error.
         MeshBuffer remeshed_mesh = create_mesh_buffer(remeshedMesh, window, allocator);
@@ -364,14 +382,28 @@ int main(int argc, char* argv[]) try
     //Create buffers for rendering
     PointBuffer pointCloudBuffer = create_pointcloud_buffers(pointCloud.positions, pointCloud.colors, pointCloud.point_size,
                                                              window, allocator);
-    auto remapped_distance_field = apply_point_size_transfer_function(distanceField.point_size);
-    PointBuffer gridBuffer = create_pointcloud_buffers(distanceField.positions, distanceField.colors, remapped_distance_field,
-                                                       window, allocator);
-    LineBuffer lineBuffer = create_index_buffer(grid_edges, edge_colors, window, allocator);
-
     pBuffer.push_back(std::move(pointCloudBuffer));
-    pBuffer.push_back(std::move(gridBuffer));
-    lBuffer.push_back(std::move(lineBuffer));
+    if(ui_config.sparse_grid) {
+        // The active vertex positions are already there, so the sparse grid buffers are always created
+        distanceField.set_color(vertex_classification);
+        EdgeClassification edge_values = classify_grid_edges(sparseGrid, grid_edges);
+        std::vector<glm::vec3> edge_colors = get_edge_colors(edge_values, grid_edges, distanceField.positions.size());
+        auto remapped_distance_field = std::visit([](auto const& scalar_values) {
+            return apply_point_size_transfer_function(scalar_values);
+        }, scalarField);
+        pBuffer.push_back(create_pointcloud_buffers(distanceField.positions, distanceField.colors, remapped_distance_field,
+                                                    window, allocator));
+        lBuffer.push_back(create_index_buffer(grid_edges, edge_colors, window, allocator));
+    } else {
+        // Created by update_grid_buffers once the dense grid is displayed
+        pBuffer.push_back(PointBuffer{});
+        lBuffer.push_back(LineBuffer{});
+    }
+
+    // Keep the field, so that changing only the isovalue does not evaluate it again
+    SurfaceCache surfaceCache;
+    cache_surface_field(surfaceCache, ui_config, grid, std::move(grid_edges), std::move(scalarField), std::move(vertex_classification));
+    update_grid_buffers(surfaceCache, ui_config, pBuffer, lBuffer, window, allocator);
 
 #endif
 
@@ -542,7 +574,8 @@ int main(int argc, char* argv[]) try
         }
 
         if (ImGui::Button("Remesh")) {
-            edgeTest.remesh(ui_config.target_edge_length,ui_config.remeshing_iterations);
+            edgeTest.remesh(ui_config.target_edge_length,ui_config.remeshing_iterations, ui_config.priority_queue_remeshing,
+                            ui_config.jacobi_relaxation, resolve_thread_count(ui_config.n_threads));
             // Wait for GPU to finish processing
             vkDeviceWaitIdle(window.device);
 
@@ -587,7 +620,7 @@ int main(int argc, char* argv[]) try
             ui_config.mc_manifold = marchingCubesMesh.check_manifold();
         }
         if (ImGui::Button("Output to file")) {
-            write_OBJ(reconstructedSurfaceIndexed, file_path);
+            write_OBJ(reconstructedSurfaceIndexed, cfg::MC_obj_name);
         }
         if (ImGui::Button("Recalculate")) {
             // Wait for GPU to finish processing
@@ -595,18 +628,23 @@ int main(int argc, char* argv[]) try
 
             std::cout << "Grid resolution : " << ui_config.grid_resolution << std::endl;
             //Recalculate MC surface
-            reconstructedSurfaceIndexed = recalculate_grid(pointCloud, distanceField, reconstructedSurface, ui_config, pointCloudBBox,pBuffer, lBuffer, mBuffer,
+            reconstructedSurfaceIndexed = recalculate_grid(pointCloud, pointCloudTree, distanceField, reconstructedSurface, marchingCubesMesh, surfaceCache,
+                                                           ui_config, pointCloudBBox,pBuffer, lBuffer, mBuffer,
                              window, allocator);
             //Recalculate remeshed surface
-            remeshedMesh = recalculate_remeshed_mesh(ui_config, window, allocator, mBuffer);
+            remeshedMesh = recalculate_remeshed_mesh(marchingCubesMesh, ui_config, window, allocator, mBuffer);
 
         }
+        // The dense grid buffers are only created once the distance field or the grid edges are displayed
+        update_grid_buffers(surfaceCache, ui_config, pBuffer, lBuffer, window, allocator);
 
         ImGui::End();
 
         ImGui::Begin("Remeshing Menu");
         ImGui::InputFloat("Target edge length", &ui_config.target_edge_length);
         ImGui::InputInt("Remeshing iterations", &ui_config.remeshing_iterations);
+        ImGui::Checkbox("Priority queue split & collapse", &ui_config.priority_queue_remeshing);
+        ImGui::Checkbox("Parallel (Jacobi) relaxation", &ui_config.jacobi_relaxation);
         ImGui::End();
 
         ImGui::Begin("Marching Cubes Mesh Metrics");
@@ -46,6 +46,9 @@ IndexedMesh::IndexedMesh(const HalfEdgeMesh& halfEdgeMesh) {
     face_indices = halfEdgeMesh.faces;
 }
 
+HalfEdgeMesh::HalfEdgeMesh(IndexedMesh const& indexedMesh) : HalfEdgeMesh(indexedMesh.positions, indexedMesh.face_indices) {
+}
+
 
 MeshBuffer create_mesh_buffer(Mesh const& mesh, labutils::VulkanContext const& window, labutils::Allocator const& allocator) {
 
@@ -6,7 +6,6 @@
 #define MARCHING_CUBES_POINT_CLOUD_MESH_HPP
 
 #include <vector>
-#include <unordered_map>
 #include <glm/vec3.hpp>
 #include "../labutils/vkbuffer.hpp"
 #include "../labutils/error.hpp"
@@ -15,15 +14,7 @@
 #include "../../incremental_remeshing/halfedge.hpp"
 
 
-template<>
-struct std::hash<glm::vec3> {
-    std::size_t operator()(const glm::vec3& v) const {
-        return ((std::hash<float>()(v.x) ^ (std::hash<float>()(v.y) << 1)) >> 1) ^ (std::hash<float>()(v.z) << 1);
-    }
-};
-
 struct IndexedMesh {
-    std::unordered_map<glm::vec3, int> vertex_idx_map;
     std::vector<glm::vec3> positions;
     std::vector<unsigned int> face_indices;
 
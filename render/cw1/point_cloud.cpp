@@ -341,3 +341,12 @@ void PointCloud::set_color(std::vector<unsigned int> const& color) {
         }
     }
 }
+
+/* Positive vertices are white, negative ones black */
+void PointCloud::set_color(VertexClassification const& classification) {
+    colors.reserve(colors.size() + classification.size());
+    for(std::size_t vertex = 0; vertex < classification.size(); vertex++) {
+        float value = classification[vertex];
+        colors.emplace_back(value, value, value);
+    }
+}
@@ -7,6 +7,7 @@
 
 #include <unordered_set>
 #include "simple_model.hpp"
+#include "../../marching_cubes/classification.hpp"
 
 struct PointCloud {
     std::vector<glm::vec3> positions;
@@ -15,6 +16,7 @@ struct PointCloud {
 
     void set_color(glm::vec3 const& color);
     void set_color(std::vector<unsigned int> const& color);
+    void set_color(VertexClassification const& classification);
     void set_size(unsigned int const& size);
 };
 
@@ -12,6 +12,8 @@
 #include "../../third_party/glm/include/glm/glm.hpp"
 
 #include "../../marching_cubes/surface_reconstruction.hpp"
+#include "../../marching_cubes/sparse_grid.hpp"
+#include "../../marching_cubes/parallel.hpp"
 
 
 namespace ui {
@@ -40,12 +42,78 @@ namespace ui {
     }
 }
 
+/* Only the brute force, KD-tree and distance transform engines evaluate the full field without looking at the isovalue; the
+ * others only evaluate the band around it. The sparse grid only keeps the band too */
+void cache_surface_field(SurfaceCache& surfaceCache, UiConfiguration const& ui_config, GridDescriptor const& grid,
+                         std::vector<uint32_t>&& grid_edges, ScalarField&& scalarField, VertexClassification&& classification) {
+    DistanceFieldEngine engine = ui_config.distance_field_engine;
+    surfaceCache.valid = !ui_config.sparse_grid && (engine == DistanceFieldEngine::brute_force || engine == DistanceFieldEngine::kd_tree ||
+                                                    engine == DistanceFieldEngine::distance_transform);
+    surfaceCache.grid_resolution = ui_config.grid_resolution;
+    surfaceCache.distance_field_engine = engine;
+    surfaceCache.scalar_field_type = ui_config.scalar_field_type;
+    surfaceCache.grid = grid;
+    surfaceCache.grid_edges = std::move(grid_edges);
+    surfaceCache.scalarField = std::move(scalarField);
+    surfaceCache.classification = std::move(classification);
+    surfaceCache.grid_buffers_current = ui_config.sparse_grid; // The sparse grid buffers are created with its active vertices
+}
+
+/* The grid lines are drawn with the grid point buffer's positions, so both buffers are needed if either is displayed */
+void update_grid_buffers(SurfaceCache& surfaceCache, UiConfiguration const& ui_config, std::vector<PointBuffer>& pBuffer,
+                         std::vector<LineBuffer>& lineBuffer, labutils::VulkanContext const& window, labutils::Allocator const& allocator) {
+    if(surfaceCache.grid_buffers_current || !(ui_config.distance_field || ui_config.grid)) return;
+
+    if(surfaceCache.grid_positions.empty()) {
+        surfaceCache.grid_positions = get_grid_positions(surfaceCache.grid);
+    }
+    PointCloud gridPoints;
+    gridPoints.set_color(surfaceCache.classification);
+    EdgeClassification edge_values = classify_grid_edges(surfaceCache.classification, surfaceCache.grid);
+    std::vector<glm::vec3> edge_colors = get_edge_colors(edge_values, surfaceCache.grid_edges, surfaceCache.grid_positions.size());
+    auto adjusted_point_size = std::visit([](auto const& scalar_values) {
+        return apply_point_size_transfer_function(scalar_values);
+    }, surfaceCache.scalarField);
+
+    // Wait for GPU to finish processing, the buffers being replaced may still be in use
+    vkDeviceWaitIdle(window.device);
+    pBuffer[1] = create_pointcloud_buffers(surfaceCache.grid_positions, gridPoints.colors, adjusted_point_size, window, allocator);
+    lineBuffer[0] = create_index_buffer(surfaceCache.grid_edges, edge_colors, window, allocator);
+    surfaceCache.grid_buffers_current = true;
+}
+
+/* Extracts the marching cubes surface with the method picked in ui_config and converts it to the halfedge data structure.
+ * With halfedge_extraction (dense grid only) the other halves are paired during the extraction instead of afterwards */
+IndexedMesh extract_surface(UiConfiguration const& ui_config, SparseGrid const& sparseGrid, GridDescriptor const& grid,
+                            VertexClassification const& vertex_classification, ScalarField const& scalarField,
+                            HalfEdgeMesh& marchingCubesMesh) {
+    unsigned int n_threads = resolve_thread_count(ui_config.n_threads);
+    if(ui_config.halfedge_extraction && !ui_config.sparse_grid) {
+        marchingCubesMesh = std::visit([&](auto const& scalar_values) {
+            return query_case_table_halfedge(vertex_classification, scalar_values, grid, ui_config.isovalue, n_threads);
+        }, scalarField);
+        return IndexedMesh(marchingCubesMesh);
+    }
+
+    IndexedMesh indexedMesh = ui_config.sparse_grid ? query_case_table(sparseGrid, ui_config.isovalue)
+                            : std::visit([&](auto const& scalar_values) {
+                                  if(ui_config.two_pass_extraction) {
+                                      return query_case_table_two_pass(vertex_classification, scalar_values, grid, ui_config.isovalue,
+                                                                       n_threads);
+                                  }
+                                  return query_case_table(vertex_classification, scalar_values, grid, ui_config.isovalue, n_threads);
+                              }, scalarField);
+    std::cout << "Creating halfedge data structure from reconstructed surface" << std::endl;
+    marchingCubesMesh = HalfEdgeMesh(indexedMesh);
+    return indexedMesh;
+}
+
 /* Deletes buffers and their allocations, recalculates grid and scalar values with given UiConfiguration
  * Populates same buffers that were deleted with updated ones
  * As this is not using a double buffer, the window will */
 //TODO: Create recalculate point cloud. Maybe will be useful to resize point size- this is secondary.
-IndexedMesh recalculate_grid(PointCloud& pointCloud, PointCloud& distanceField, Mesh& triangles,
-                      UiConfiguration& ui_config, BoundingBox& bbox,
+IndexedMesh recalculate_grid(PointCloud& pointCloud, KDTree const& pointCloudTree, PointCloud& distanceField, Mesh& triangles,
+                      HalfEdgeMesh& marchingCubesMesh, SurfaceCache& surfaceCache, UiConfiguration& ui_config, BoundingBox& bbox,
                       std::vector<PointBuffer>& pBuffer, std::vector<LineBuffer>& lineBuffer, std::vector<MeshBuffer>& mBuffer,
                       labutils::VulkanContext const& window, labutils::Allocator const& allocator) {
 
@@ -70,13 +138,59 @@ IndexedMesh recalculate_grid(PointCloud& pointCloud, PointCloud& distanceField,
     distanceField.positions.clear();
     distanceField.colors.clear();
     distanceField.point_size.clear();
-    distanceField.positions = create_regular_grid(ui_config.grid_resolution, grid_edges, bbox);
-    distanceField.point_size = calculate_distance_field(distanceField.positions, pointCloud.positions);
-    std::vector<unsigned int> vertex_classification = classify_grid_vertices(distanceField.point_size, ui_config.isovalue);
-    distanceField.set_color(vertex_classification);
+    GridDescriptor grid;
+    SparseGrid sparseGrid;
+    VertexClassification vertex_classification;
+    ScalarField scalarField; // Scalar values at the grid vertices (or the active vertices of the sparse grid)
+    // The field does not depend on the isovalue, so it is reused if nothing else it depends on changed
+    bool const reuse_field = surfaceCache.valid && !ui_config.sparse_grid && surfaceCache.grid_resolution == ui_config.grid_resolution &&
+                             surfaceCache.distance_field_engine == ui_config.distance_field_engine &&
+                             surfaceCache.scalar_field_type == ui_config.scalar_field_type;
+    if(reuse_field) {
+        std::cout << "Reusing the distance field of the last calculation" << std::endl;
+        grid = surfaceCache.grid;
+        grid_edges = std::move(surfaceCache.grid_edges);
+        scalarField = std::move(surfaceCache.scalarField);
+        vertex_classification = std::visit([&](auto const& scalar_values) {
+            return classify_grid_vertices(scalar_values, ui_config.isovalue);
+        }, scalarField);
+    } else if(ui_config.sparse_grid) {
+        surfaceCache.meshStore = BlockMeshStore();
+        surfaceCache.grid_positions.clear();
+        sparseGrid = create_sparse_grid(pointCloud.positions, get_grid_descriptor(ui_config.grid_resolution, bbox), ui_config.isovalue);
+        calculate_distance_field(sparseGrid, pointCloudTree, resolve_thread_count(ui_config.n_threads));
+        classify_grid_vertices(sparseGrid, ui_config.isovalue);
+        std::vector<int> active_scalar_values;
+        get_active_vertices(sparseGrid, distanceField.positions, active_scalar_values, vertex_classification);
+        scalarField = std::move(active_scalar_values);
+    } else {
+        surfaceCache.meshStore = BlockMeshStore();
+        grid = create_regular_grid(ui_config.grid_resolution, grid_edges, bbox);
+        surfaceCache.grid_positions.clear(); // Built again for the new grid once it is displayed
+        scalarField = evaluate_distance_field(ui_config.scalar_field_type, ui_config.distance_field_engine, grid, pointCloud.positions,
+                                              pointCloudTree, ui_config.isovalue, ui_config.n_threads);
+        vertex_classification = std::visit([&](auto const& scalar_values) {
+            return classify_grid_vertices(scalar_values, ui_config.isovalue);
+        }, scalarField);
+    }
 
-    IndexedMesh case_triangles_indexed =  query_case_table(vertex_classification,  distanceField.positions,
-            distanceField.point_size, ui_config.grid_resolution, bbox, ui_config.isovalue);
+    IndexedMesh case_triangles_indexed;
+    if(reuse_field) {
+        // Only the blocks with a cube whose case changed are marched again
+        unsigned int n_threads = resolve_thread_count(ui_config.n_threads);
+        if(surfaceCache.meshStore.blocks.empty()) {
+            surfaceCache.meshStore = create_block_mesh_store(vertex_classification, grid, ui_config.isovalue, n_threads);
+        } else {
+            update_isovalue(surfaceCache.meshStore, vertex_classification, ui_config.isovalue, n_threads);
+        }
+        case_triangles_indexed = std::visit([&](auto const& scalar_values) {
+            return query_case_table(surfaceCache.meshStore, scalar_values, n_threads);
+        }, scalarField);
+        std::cout << "Creating halfedge data structure from reconstructed surface" << std::endl;
+        marchingCubesMesh = HalfEdgeMesh(case_triangles_indexed);
+    } else {
+        case_triangles_indexed = extract_surface(ui_config, sparseGrid, grid, vertex_classification, scalarField, marchingCubesMesh);
+    }
 
     Mesh case_triangles(case_triangles_indexed);
     case_triangles.set_color(glm::vec3{1, 0, 0});
@@ -97,9 +211,7 @@ IndexedMesh recalculate_grid(PointCloud& pointCloud, PointCloud& distanceField,
     } else {
         mBuffer[0].vertexCount = 0;
     }
-    //Create file and convert to HalfEdge data structure
-    write_OBJ(case_triangles_indexed, cfg::MC_obj_name);
-    HalfEdgeMesh marchingCubesMesh = obj_to_halfedge(cfg::MC_obj_name);
+    if(ui_config.write_obj) write_OBJ(case_triangles_indexed, cfg::MC_obj_name);
     ui_config.mc_manifold = marchingCubesMesh.check_manifold();
 
     //Calculate metrics for MC surface
@@ -107,27 +219,38 @@ IndexedMesh recalculate_grid(PointCloud& pointCloud, PointCloud& distanceField,
     marchingCubesMesh.calculate_triangle_area_metrics();
     ui_config.p_cloud_to_MC_mesh = marchingCubesMesh.calculate_hausdorff_distance(pointCloud.positions);
 
-    auto [edge_values, edge_colors] = classify_grid_edges(vertex_classification, bbox, ui_config.grid_resolution);
+    if(ui_config.sparse_grid) {
+        // The active vertex positions are already there, so the sparse grid buffers are always created
+        distanceField.set_color(vertex_classification);
+        EdgeClassification edge_values = classify_grid_edges(sparseGrid, grid_edges);
+        std::vector<glm::vec3> edge_colors = get_edge_colors(edge_values, grid_edges, distanceField.positions.size());
 
-    //Create buffers for rendering
-    //Map distance field values to something more meaningful using a transfer function.
-    auto adjusted_point_size = apply_point_size_transfer_function(distanceField.point_size);
+        //Create buffers for rendering
+        //Map distance field values to something more meaningful using a transfer function.
+        auto adjusted_point_size = std::visit([](auto const& scalar_values) {
+            return apply_point_size_transfer_function(scalar_values);
+        }, scalarField);
 
-    PointBuffer gridPointBuffer = create_pointcloud_buffers(distanceField.positions, distanceField.colors, adjusted_point_size,
-                                                       window, allocator);
+        PointBuffer gridPointBuffer = create_pointcloud_buffers(distanceField.positions, distanceField.colors, adjusted_point_size,
+                                                           window, allocator);
 
-    LineBuffer gridLineBuffer = create_index_buffer(grid_edges, edge_colors, window, allocator);
+        LineBuffer gridLineBuffer = create_index_buffer(grid_edges, edge_colors, window, allocator);
 
-    pBuffer[1] = (std::move(gridPointBuffer)); // Point buffer for grid points
-    lineBuffer[0]  = (std::move(gridLineBuffer)); // Line buffer for grid lines
+        pBuffer[1] = (std::move(gridPointBuffer)); // Point buffer for grid points
+        lineBuffer[0]  = (std::move(gridLineBuffer)); // Line buffer for grid lines
+    }
+    cache_surface_field(surfaceCache, ui_config, grid, std::move(grid_edges), std::move(scalarField), std::move(vertex_classification));
+    update_grid_buffers(surfaceCache, ui_config, pBuffer, lineBuffer, window, allocator); // Dense grid, if it is displayed
     std::cout << "Continue rendering with new buffers" << std::endl;
 
     return case_triangles_indexed;
 }
 
-HalfEdgeMesh recalculate_remeshed_mesh(UiConfiguration& ui_config, labutils::VulkanContext const& window, labutils::Allocator const& allocator,std::vector<MeshBuffer>& mBuffer) {
-    HalfEdgeMesh remeshed = obj_to_halfedge(cfg::MC_obj_name);
-    remeshed.remesh(ui_config.target_edge_length, ui_config.remeshing_iterations);
+HalfEdgeMesh recalculate_remeshed_mesh(HalfEdgeMesh const& mc_mesh, UiConfiguration& ui_config, labutils::VulkanContext const& window,
+                                       labutils::Allocator const& allocator, std::vector<MeshBuffer>& mBuffer) {
+    HalfEdgeMesh remeshed = mc_mesh;
+    remeshed.remesh(ui_config.target_edge_length, ui_config.remeshing_iterations, ui_config.priority_queue_remeshing,
+                    ui_config.jacobi_relaxation, resolve_thread_count(ui_config.n_threads));
     // Wait for GPU to finish processing
     vkDeviceWaitIdle(window.device);
 
@@ -12,6 +12,8 @@
 #include "vkobject.hpp"
 #include "../cw1/point_cloud.hpp"
 #include "../../marching_cubes/distance_field.hpp"
+#include "../../marching_cubes/sparse_grid.hpp"
+#include "../../marching_cubes/surface_reconstruction.hpp"
 #include "../cw1/mesh.hpp"
 
 /* General UI helper functions */
@@ -29,8 +31,17 @@ struct UiConfiguration {
     int point_cloud_size = 5;
     const int p_cloud_size_min = 1, p_cloud_size_max = 10;
     int isovalue = 2; //TODO: limit max / min depending on data.
+    DistanceFieldEngine distance_field_engine = DistanceFieldEngine::kd_tree;
+    int n_threads = 0; // 0 uses all hardware threads
+    bool sparse_grid = false; // Only allocate the band of the grid close to the point cloud (KD-tree distances)
+    ScalarFieldType scalar_field_type = ScalarFieldType::int32; // Storage width of the dense scalar field
+    bool two_pass_extraction = false; // Count the marching cubes output before writing it (dense grid only)
+    bool halfedge_extraction = false; // Pair the halfedges while extracting the marching cubes mesh (dense grid only)
+    bool write_obj = false; // Write the marching cubes and remeshed meshes to .obj files on every calculation
     float target_edge_length = 0.0f;
     int remeshing_iterations = 10;
+    bool priority_queue_remeshing = false; // Split the longest and collapse the shortest edges first, from a priority queue
+    bool jacobi_relaxation = false; // Relax all vertices at once from the previous positions, on n_threads threads
 
     bool mc_manifold = false, remesh_manifold = false;
     bool flyCamera = true;
@@ -41,12 +52,44 @@ struct UiConfiguration {
 
 };
 
-// Recalculates grid and scalar values with given UiConfiguration
-IndexedMesh recalculate_grid(PointCloud& pointCloud, PointCloud& distanceField, Mesh& triangles,
-                      UiConfiguration& ui_config, BoundingBox& bbox,
+// Dense grid and scalar field of the last calculation. The distance field engines which do not use the isovalue give the same
+// field at every isovalue, so changing only the isovalue reuses it, and only marches again the blocks whose cubes changed case
+struct SurfaceCache {
+    bool valid = false; // The field below can be reused at another isovalue
+    float grid_resolution = 0.0f;
+    DistanceFieldEngine distance_field_engine = DistanceFieldEngine::kd_tree;
+    ScalarFieldType scalar_field_type = ScalarFieldType::int32;
+    GridDescriptor grid{};
+    std::vector<glm::vec3> grid_positions; // Positions of the grid vertices, only built once the grid is displayed
+    std::vector<uint32_t> grid_edges; // An edge is the indices of its two vertices in the grid_positions array
+    ScalarField scalarField;
+    VertexClassification classification; // Grid vertex classification at the isovalue of the last calculation
+    bool grid_buffers_current = true; // The grid point and edge buffers show this grid (always for the sparse grid)
+    BlockMeshStore meshStore; // Marching cubes triangles per block, created on the first isovalue change
+};
+
+// Keeps the grid, scalar field and classification of a calculation with given UiConfiguration in the cache
+void cache_surface_field(SurfaceCache& surfaceCache, UiConfiguration const& ui_config, GridDescriptor const& grid,
+                         std::vector<uint32_t>&& grid_edges, ScalarField&& scalarField, VertexClassification&& classification);
+
+// Creates the point and edge buffers of the cached dense grid if the distance field or the grid edges are displayed and the
+// buffers do not show this grid yet. The grid vertex positions are only built then, and kept for later isovalue changes
+void update_grid_buffers(SurfaceCache& surfaceCache, UiConfiguration const& ui_config, std::vector<PointBuffer>& pBuffer,
+                         std::vector<LineBuffer>& lineBuffer, labutils::VulkanContext const& window, labutils::Allocator const& allocator);
+
+// Extracts the marching cubes surface with given UiConfiguration, and its halfedge data structure into marchingCubesMesh
+IndexedMesh extract_surface(UiConfiguration const& ui_config, SparseGrid const& sparseGrid, GridDescriptor const& grid,
+                            VertexClassification const& vertex_classification, ScalarField const& scalarField,
+                            HalfEdgeMesh& marchingCubesMesh);
+
+// Recalculates grid and scalar values with given UiConfiguration, reusing the cached ones if only the isovalue changed
+IndexedMesh recalculate_grid(PointCloud& pointCloud, KDTree const& pointCloudTree, PointCloud& distanceField, Mesh& triangles,
+                      HalfEdgeMesh& marchingCubesMesh, SurfaceCache& surfaceCache, UiConfiguration& ui_config, BoundingBox& bbox,
                       std::vector<PointBuffer>& pBuffer, std::vector<LineBuffer>& lineBuffer, std::vector<MeshBuffer>& mBuffer,
                       labutils::VulkanContext const& window, labutils::Allocator const& allocator);
 
-HalfEdgeMesh recalculate_remeshed_mesh(UiConfiguration& ui_config, labutils::VulkanContext const& window, labutils::Allocator const& allocator,std::vector<MeshBuffer>& mBuffer);
+// Remeshes the marching cubes mesh with given UiConfiguration
+HalfEdgeMesh recalculate_remeshed_mesh(HalfEdgeMesh const& mc_mesh, UiConfiguration& ui_config, labutils::VulkanContext const& window,
+                                       labutils::Allocator const& allocator, std::vector<MeshBuffer>& mBuffer);
 
 #endif //MARCHING_CUBES_POINT_CLOUD_UI_HPP
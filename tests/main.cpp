@@ -0,0 +1,24 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+
+#include <iostream>
+#include <string>
+
+/* Runs every test (or the ones whose name contains the first argument). Exits with 1 if any check failed */
+int main(int argc, char** argv) {
+    std::string const filter = (argc > 1) ? argv[1] : "";
+    unsigned int n_run = 0;
+    for(TestCase const& test : get_tests()) {
+        if(std::string(test.name).find(filter) == std::string::npos) continue;
+        unsigned int const failed_before = get_failed_check_count();
+        std::cout << "[ RUN  ] " << test.name << std::endl;
+        test.function();
+        std::cout << ((get_failed_check_count() == failed_before) ? "[  OK  ] " : "[ FAIL ] ") << test.name << std::endl;
+        n_run++;
+    }
+    std::cout << n_run << " tests run, " << get_failed_check_count() << " failed checks" << std::endl;
+    return (get_failed_check_count() == 0) ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../marching_cubes/case_index.hpp"
+#include "../marching_cubes/surface_reconstruction.hpp"
+
+#include <random>
+#include <array>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    // Case index of cube n of the chunk from its eight corners, in the corner order of mc_tables.h
+    unsigned int get_reference_case(std::uint64_t const (&row_bits)[4], int const& cube) {
+        auto bit = [&](int row, int shift) { return (unsigned int)((row_bits[row] >> (cube + shift)) & 1u); };
+        unsigned int const vertex_values[8] = {bit(0, 0), bit(1, 0), bit(0, 1), bit(1, 1),
+                                               bit(2, 0), bit(3, 0), bit(2, 1), bit(3, 1)};
+        return get_case(vertex_values);
+    }
+
+    // Random rows, plus rows that are all 0, all 1, and alternating
+    std::vector<std::array<std::uint64_t, 4>> get_test_rows() {
+        std::vector<std::array<std::uint64_t, 4>> rows = {
+                {0, 0, 0, 0}, {~0ull, ~0ull, ~0ull, ~0ull}, {0x5555555555555555, 0xAAAAAAAAAAAAAAAA, 0xAAAAAAAAAAAAAAAA, 0x5555555555555555}};
+        std::mt19937_64 random(7);
+        for(int n = 0; n < 2000; n++) {
+            rows.push_back({random(), random(), random(), random()});
+        }
+        return rows;
+    }
+}
+
+TEST(chunk_cases_match_per_cube_case) {
+    // Cube 63 would need bit 64, so it is not meaningful (see get_chunk_cases)
+    for(char const* kernel : {"avx2", "sse4.1", "scalar"}) {
+        bool supported = true;
+        bool same = true;
+        for(auto const& test_rows : get_test_rows()) {
+            std::uint64_t const row_bits[4] = {test_rows[0], test_rows[1], test_rows[2], test_rows[3]};
+            std::uint8_t cases[CASE_CHUNK_SIZE];
+            supported = get_chunk_cases(kernel, row_bits, cases);
+            if(!supported) break;
+            for(int cube = 0; cube < CASE_CHUNK_SIZE - 1; cube++) {
+                same = same && cases[cube] == get_reference_case(row_bits, cube);
+            }
+        }
+        std::cout << "Case index kernel " << kernel << (supported ? " checked" : " not supported, skipped") << std::endl;
+        CHECK(same);
+    }
+}
+
+TEST(default_chunk_cases_kernel_is_supported) {
+    std::uint64_t const row_bits[4] = {0x0123456789ABCDEF, 0xFEDCBA9876543210, 0x0F0F0F0F0F0F0F0F, 0xF0F0F0F0F0F0F0F0};
+    std::uint8_t cases[CASE_CHUNK_SIZE];
+    std::uint8_t named_cases[CASE_CHUNK_SIZE];
+    get_chunk_cases(row_bits, cases);
+    CHECK(get_chunk_cases(case_index_kernel_name(), row_bits, named_cases));
+    CHECK(std::equal(cases, cases + CASE_CHUNK_SIZE, named_cases));
+    CHECK(!get_chunk_cases("avx512", row_bits, named_cases));
+}
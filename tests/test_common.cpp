@@ -0,0 +1,67 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../marching_cubes/distance_field.hpp"
+#include "../marching_cubes/surface_reconstruction.hpp"
+#include "../marching_cubes/kd_tree.hpp"
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+namespace {
+    unsigned int n_failed_checks = 0;
+}
+
+std::vector<TestCase>& get_tests() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+unsigned int get_failed_check_count() {
+    return n_failed_checks;
+}
+
+void check(bool const& condition, char const* expression, char const* file, int const& line) {
+    if(condition) return;
+    n_failed_checks++;
+    std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+}
+
+std::vector<glm::vec3> get_sphere_points(glm::vec3 const& centre, float const& radius, unsigned int const& n_points) {
+    float const golden_angle = 3.14159265f * (3.0f - std::sqrt(5.0f));
+    std::vector<glm::vec3> points;
+    points.reserve(n_points);
+    for(unsigned int n = 0; n < n_points; n++) {
+        float y = 1.0f - 2.0f * (n + 0.5f) / n_points;
+        float ring_radius = std::sqrt(1.0f - y * y);
+        float angle = golden_angle * n;
+        points.push_back(centre + radius * glm::vec3{ring_radius * std::cos(angle), y, ring_radius * std::sin(angle)});
+    }
+    return points;
+}
+
+std::vector<glm::vec3> get_random_points(glm::vec3 const& min, glm::vec3 const& max, unsigned int const& n_points, unsigned int const& seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> x(min.x, max.x), y(min.y, max.y), z(min.z, max.z);
+    std::vector<glm::vec3> points(n_points);
+    for(auto& point : points) {
+        point = {x(generator), y(generator), z(generator)};
+    }
+    return points;
+}
+
+GridDescriptor get_test_grid(std::vector<glm::vec3> const& points, float const& grid_resolution, float const& padding) {
+    BoundingBox bbox = get_bounding_box(points);
+    bbox.add_padding(padding);
+    return get_grid_descriptor(grid_resolution, bbox);
+}
+
+IndexedMesh get_sphere_surface(float const& radius, float const& grid_resolution) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), radius, (unsigned int)(20.0f * radius * radius));
+    GridDescriptor grid = get_test_grid(points, grid_resolution);
+    std::vector<int> scalar_values = calculate_distance_field<int>(grid, KDTree(points), 1);
+    return query_case_table(classify_grid_vertices(scalar_values, 1), scalar_values, grid, 1.0f);
+}
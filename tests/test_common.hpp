@@ -0,0 +1,54 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#ifndef MARCHING_CUBES_POINT_CLOUD_TEST_COMMON_HPP
+#define MARCHING_CUBES_POINT_CLOUD_TEST_COMMON_HPP
+
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "../marching_cubes/grid.hpp"
+#include "../render/cw1/mesh.hpp"
+
+/* Minimal test harness. TEST(name) defines a test and registers it, CHECK(condition) reports a failed condition and lets the
+ * test carry on. Every new path is checked against the path it replaces (scalar, serial or brute force) on small inputs */
+struct TestCase {
+    char const* name;
+    void (*function)();
+};
+
+std::vector<TestCase>& get_tests();
+
+struct TestRegistration {
+    TestRegistration(char const* name, void (*function)()) {
+        get_tests().push_back({name, function});
+    }
+};
+
+// Number of failed checks so far, over all tests
+unsigned int get_failed_check_count();
+
+void check(bool const& condition, char const* expression, char const* file, int const& line);
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration const name##_registration(#name, name); \
+    static void name()
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+// Points on the sphere of the given centre and radius (Fibonacci lattice), so tests do not depend on the assets
+std::vector<glm::vec3> get_sphere_points(glm::vec3 const& centre, float const& radius, unsigned int const& n_points);
+
+// Points uniformly distributed in the box [min, max], from a fixed seed
+std::vector<glm::vec3> get_random_points(glm::vec3 const& min, glm::vec3 const& max, unsigned int const& n_points, unsigned int const& seed);
+
+// Grid covering the points with the given resolution and padding, like the application builds it
+GridDescriptor get_test_grid(std::vector<glm::vec3> const& points, float const& grid_resolution, float const& padding = 0.25f);
+
+// Closed marching cubes surface around a sphere point cloud (isovalue 1), extracted at the given grid resolution. It is
+// made of two spheres, just outside and just inside the points
+IndexedMesh get_sphere_surface(float const& radius, float const& grid_resolution);
+
+#endif //MARCHING_CUBES_POINT_CLOUD_TEST_COMMON_HPP
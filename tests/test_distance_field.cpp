@@ -0,0 +1,138 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../marching_cubes/distance_field.hpp"
+#include "../marching_cubes/kd_tree.hpp"
+#include "../marching_cubes/distance_transform.hpp"
+#include "../marching_cubes/surface_reconstruction.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <cmath>
+
+namespace {
+    int brute_force_nearest_distance(std::vector<glm::vec3> const& points, glm::vec3 const& query) {
+        int nearest = std::numeric_limits<int>::max();
+        for(auto const& point : points) {
+            nearest = std::min(nearest, (int)glm::distance(query, point));
+        }
+        return nearest;
+    }
+
+    /* The engine only computes the distances the surface depends on, so at every isovalue and grid scale the vertices must
+     * classify the same as with the kd_tree field, and the dense mesh must be the same (same vertices, in the same order) */
+    void check_engine_matches_kd_tree(DistanceFieldEngine const& engine) {
+        std::vector<glm::vec3> points = get_sphere_points(glm::vec3(2.0f), 9.0f, 700);
+        KDTree tree(points);
+        for(float grid_resolution : {0.5f, 1.0f, 2.5f}) { // Grid scales 2, 1 and 0.4
+            GridDescriptor grid = get_test_grid(points, grid_resolution);
+            std::vector<int> full = calculate_distance_field<int>(grid, tree, 1);
+            for(int isovalue : {1, 2, 4}) {
+                std::vector<int> partial = evaluate_distance_field<int>(engine, grid, points, tree, isovalue, 2);
+                VertexClassification expected_classification = classify_grid_vertices(full, isovalue);
+                VertexClassification classification = classify_grid_vertices(partial, isovalue);
+                CHECK(classification.words == expected_classification.words);
+
+                IndexedMesh expected = query_case_table(expected_classification, full, grid, (float)isovalue);
+                IndexedMesh mesh = query_case_table(classification, partial, grid, (float)isovalue);
+                CHECK(!expected.face_indices.empty());
+                CHECK(mesh.positions == expected.positions && mesh.face_indices == expected.face_indices);
+            }
+        }
+    }
+}
+
+TEST(kd_tree_nearest_distance_matches_brute_force) {
+    std::vector<glm::vec3> points = get_random_points(glm::vec3(-20.0f), glm::vec3(20.0f), 500, 1);
+    KDTree tree(points);
+    for(auto const& query : get_random_points(glm::vec3(-30.0f), glm::vec3(30.0f), 2000, 2)) {
+        int expected = brute_force_nearest_distance(points, query);
+        CHECK(tree.nearest_distance(query) == expected);
+        CHECK(tree.any_within(query, expected));
+        CHECK(expected == 0 || !tree.any_within(query, expected - 1));
+    }
+}
+
+TEST(kd_tree_distance_field_matches_brute_force) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(5.0f), 8.0f, 400);
+    GridDescriptor grid = get_test_grid(points, 1.0f);
+    CHECK(calculate_distance_field<int>(grid, KDTree(points), 1) == calculate_distance_field<int>(grid, points, 1));
+}
+
+/* Snapping every point to its closest grid vertex moves it by at most half a cell diagonal, so the truncated distances differ
+ * from the brute force ones by at most ceil(scale * sqrt(3) / 2) */
+TEST(distance_transform_within_snapping_bound_of_brute_force) {
+    std::vector<glm::vec3> points = get_random_points(glm::vec3(0.0f), glm::vec3(40.0f), 300, 3);
+    for(float grid_resolution : {1.0f, 0.5f, 0.25f}) {
+        GridDescriptor grid = get_test_grid(points, grid_resolution);
+        std::vector<int> brute_force = calculate_distance_field<int>(grid, points, 1);
+        std::vector<int> transform = calculate_distance_transform<int>(points, grid, 1);
+        int const bound = (int)std::ceil(grid.scale * std::sqrt(3.0f) / 2.0f);
+        int max_difference = 0;
+        for(std::size_t vertex = 0; vertex < brute_force.size(); vertex++) {
+            max_difference = std::max(max_difference, std::abs(brute_force[vertex] - transform[vertex]));
+        }
+        CHECK(max_difference <= bound);
+    }
+}
+
+namespace {
+    // The narrow field must be the int field saturated to the type's range, and give the same surface when the isovalue fits
+    template<typename Scalar>
+    void check_narrow_field_matches_int(std::vector<glm::vec3> const& points, GridDescriptor const& grid, int const& isovalue) {
+        KDTree tree(points);
+        std::vector<int> full = evaluate_distance_field<int>(DistanceFieldEngine::kd_tree, grid, points, tree, isovalue, 2);
+        std::vector<Scalar> narrow = evaluate_distance_field<Scalar>(DistanceFieldEngine::kd_tree, grid, points, tree, isovalue, 2);
+        bool saturated = narrow.size() == full.size();
+        for(std::size_t vertex = 0; saturated && vertex < full.size(); vertex++) {
+            saturated = narrow[vertex] == std::min(full[vertex], (int)std::numeric_limits<Scalar>::max());
+        }
+        CHECK(saturated);
+
+        CHECK(scalar_field_fits<Scalar>(isovalue, grid.scale));
+        VertexClassification expected_classification = classify_grid_vertices(full, isovalue);
+        VertexClassification classification = classify_grid_vertices(narrow, isovalue);
+        CHECK(classification.words == expected_classification.words);
+        IndexedMesh expected = query_case_table(expected_classification, full, grid, (float)isovalue);
+        IndexedMesh mesh = query_case_table(classification, narrow, grid, (float)isovalue);
+        CHECK(!expected.face_indices.empty());
+        CHECK(mesh.positions == expected.positions && mesh.face_indices == expected.face_indices);
+    }
+}
+
+TEST(narrow_scalar_fields_match_int_field) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(2.0f), 9.0f, 700);
+    GridDescriptor grid = get_test_grid(points, 1.0f);
+    for(int isovalue : {1, 3}) {
+        check_narrow_field_matches_int<std::uint8_t>(points, grid, isovalue);
+        check_narrow_field_matches_int<std::uint16_t>(points, grid, isovalue);
+    }
+}
+
+TEST(narrow_scalar_fields_saturate_instead_of_wrapping) {
+    CHECK(saturate_scalar<std::uint8_t>(255) == 255 && saturate_scalar<std::uint8_t>(256) == 255);
+    CHECK(saturate_scalar<std::uint8_t>(300) == 255 && saturate_scalar<std::uint8_t>(-1) == 0);
+    CHECK(saturate_scalar<std::uint16_t>(65536) == 65535 && saturate_scalar<std::uint16_t>(70000) == 65535);
+    CHECK(saturate_scalar<int>(70000) == 70000);
+
+    // Two clusters 600 apart: most of the grid between them is further than 255 from every point
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 6.0f, 200);
+    std::vector<glm::vec3> far_points = get_sphere_points(glm::vec3(600.0f, 0.0f, 0.0f), 6.0f, 200);
+    points.insert(points.end(), far_points.begin(), far_points.end());
+    GridDescriptor grid = get_test_grid(points, 0.25f); // Grid scale 4
+    std::vector<int> full = calculate_distance_field<int>(grid, KDTree(points), 1);
+    CHECK(*std::max_element(full.begin(), full.end()) > 255);
+    check_narrow_field_matches_int<std::uint8_t>(points, grid, 2);
+}
+
+TEST(classify_first_surface_matches_kd_tree) {
+    check_engine_matches_kd_tree(DistanceFieldEngine::classify_first);
+}
+
+TEST(coarse_to_fine_surface_matches_kd_tree) {
+    check_engine_matches_kd_tree(DistanceFieldEngine::coarse_to_fine);
+}
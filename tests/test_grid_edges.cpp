@@ -0,0 +1,77 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../marching_cubes/distance_field.hpp"
+#include "../marching_cubes/sparse_grid.hpp"
+#include "../marching_cubes/kd_tree.hpp"
+
+#include <stdexcept>
+
+TEST(regular_grid_edges_are_in_range) {
+    BoundingBox bbox{glm::vec3(-3.0f), glm::vec3(4.0f, 5.0f, 6.0f)};
+    std::vector<uint32_t> grid_edges;
+    GridDescriptor grid = create_regular_grid(1.0f, grid_edges, bbox);
+    glm::ivec3 const& dims = grid.dims;
+    std::size_t expected_edges = (std::size_t)(dims.x - 1) * dims.y * dims.z + (std::size_t)dims.x * (dims.y - 1) * dims.z
+                                 + (std::size_t)dims.x * dims.y * (dims.z - 1);
+    CHECK(grid_edges.size() == 2 * expected_edges);
+    bool in_range = true;
+    for(uint32_t index : grid_edges) in_range = in_range && index < grid.vertex_count();
+    CHECK(in_range);
+}
+
+TEST(regular_grid_too_large_for_32_bit_edges_throws) {
+    BoundingBox bbox{glm::vec3(0.0f), glm::vec3(2000.0f)}; // About 8 billion vertices, rejected before any edge is added
+    std::vector<uint32_t> grid_edges;
+    bool thrown = false;
+    try {
+        create_regular_grid(1.0f, grid_edges, bbox);
+    } catch(std::length_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(grid_edges.empty());
+}
+
+TEST(sparse_grid_edges_are_in_range) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 12.0f, 800);
+    GridDescriptor descriptor = get_test_grid(points, 1.0f);
+    int isovalue = 1;
+    SparseGrid grid = create_sparse_grid(points, descriptor, isovalue);
+    calculate_distance_field(grid, KDTree(points), 1);
+    classify_grid_vertices(grid, isovalue);
+
+    std::vector<glm::vec3> positions;
+    std::vector<int> scalar_values;
+    VertexClassification classification;
+    get_active_vertices(grid, positions, scalar_values, classification);
+    std::vector<uint32_t> grid_edges;
+    EdgeClassification edge_values = classify_grid_edges(grid, grid_edges);
+    CHECK(!grid_edges.empty());
+    CHECK(grid_edges.size() == 2 * edge_values.size());
+    bool in_range = true;
+    for(uint32_t index : grid_edges) in_range = in_range && index < positions.size();
+    CHECK(in_range);
+}
+
+TEST(sparse_grid_too_large_for_32_bit_edges_throws) {
+    SparseGrid grid{};
+    grid.descriptor = GridDescriptor{.origin = glm::vec3(0.0f), .scale = 1.0f, .dims = glm::ivec3(2)};
+    grid.block_dims = glm::ivec3(1);
+    SparseBlock block{};
+    block.extent = glm::ivec3(2);
+    block.first_vertex = std::size_t(1) << 32; // As if 2^32 vertices came before this block
+    grid.blocks.push_back(block);
+    grid.block_lookup[0] = 0;
+
+    std::vector<uint32_t> grid_edges;
+    bool thrown = false;
+    try {
+        classify_grid_edges(grid, grid_edges);
+    } catch(std::length_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
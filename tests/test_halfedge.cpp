@@ -0,0 +1,185 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../incremental_remeshing/halfedge.hpp"
+#include "../marching_cubes/surface_reconstruction.hpp"
+
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    /* Pairing by looking up every edge in an ordered map, the way set_other_halves worked before the radix sort. Halfedges of
+     * edges with exactly one halfedge each way are paired, edges with a single halfedge are boundary, the rest non-manifold */
+    std::vector<int> get_reference_other_halves(HalfEdgeMesh& mesh, EdgePairingReport& report) {
+        std::map<std::pair<int, int>, std::vector<int>> edges;
+        for(int halfedge = 0; halfedge < (int)mesh.halfedges_vertex_to.size(); halfedge++) {
+            int from = mesh.get_vertex_from(halfedge);
+            int to = mesh.halfedges_vertex_to[halfedge];
+            edges[{std::min(from, to), std::max(from, to)}].push_back(halfedge);
+        }
+        std::vector<int> other_halves(mesh.halfedges_vertex_to.size(), -1);
+        for(auto const& [edge, halfedges] : edges) {
+            if(halfedges.size() == 1) {
+                report.boundary_halfedges.push_back(halfedges[0]);
+            } else if(halfedges.size() == 2 && mesh.get_vertex_from(halfedges[1]) == mesh.halfedges_vertex_to[halfedges[0]]) {
+                other_halves[halfedges[0]] = halfedges[1];
+                other_halves[halfedges[1]] = halfedges[0];
+            } else {
+                report.non_manifold_halfedges.insert(report.non_manifold_halfedges.end(), halfedges.begin(), halfedges.end());
+            }
+        }
+        return other_halves;
+    }
+
+    void check_pairing_matches_reference(HalfEdgeMesh& mesh) {
+        EdgePairingReport report = mesh.set_other_halves();
+        EdgePairingReport expected_report;
+        CHECK(mesh.halfedges_opposite == get_reference_other_halves(mesh, expected_report));
+        for(auto* halfedges : {&report.boundary_halfedges, &report.non_manifold_halfedges,
+                               &expected_report.boundary_halfedges, &expected_report.non_manifold_halfedges}) {
+            std::sort(halfedges->begin(), halfedges->end());
+        }
+        CHECK(report.boundary_halfedges == expected_report.boundary_halfedges);
+        CHECK(report.non_manifold_halfedges == expected_report.non_manifold_halfedges);
+    }
+}
+
+TEST(radix_pairing_matches_reference_on_closed_surface) {
+    IndexedMesh surface = get_sphere_surface(8.0f, 1.0f);
+    HalfEdgeMesh mesh(surface.positions, surface.face_indices);
+    check_pairing_matches_reference(mesh);
+    CHECK(std::find(mesh.halfedges_opposite.begin(), mesh.halfedges_opposite.end(), -1) == mesh.halfedges_opposite.end());
+}
+
+TEST(radix_pairing_matches_reference_with_large_vertex_indices) {
+    // Vertex indices above 2^16 make every 16 bit digit of the edge keys non-zero, so none of the radix passes is skipped
+    std::vector<glm::vec3> positions(300000, glm::vec3(0.0f));
+    std::vector<unsigned int> faces = {0, 70000, 299999, 70000, 0, 150000, 299999, 70000, 150000, 0, 299999, 150000};
+    HalfEdgeMesh mesh(positions, faces);
+    check_pairing_matches_reference(mesh);
+    CHECK(std::find(mesh.halfedges_opposite.begin(), mesh.halfedges_opposite.end(), -1) == mesh.halfedges_opposite.end());
+}
+
+TEST(radix_pairing_reports_boundary_and_non_manifold_edges) {
+    std::vector<glm::vec3> positions(11, glm::vec3(0.0f));
+    std::vector<unsigned int> faces = {
+            0, 1, 2, 2, 1, 3,  // Paired along 1-2, the other 4 edges are boundary
+            4, 5, 6, 5, 4, 6,  // Closed pair of triangles
+            0, 1, 4, 1, 0, 5,  // Edge 0-1 now has three faces (non-manifold), 1-4, 4-0, 0-5 and 5-1 are boundary
+            7, 8, 9, 7, 8, 10  // Edge 7-8 has two faces with opposite orientations (non-manifold), the other 4 edges are boundary
+    };
+    HalfEdgeMesh mesh(positions, faces);
+    EdgePairingReport report = mesh.set_other_halves();
+    CHECK(report.boundary_halfedges.size() == 11);
+    CHECK(report.non_manifold_halfedges.size() == 5);
+    check_pairing_matches_reference(mesh);
+}
+
+TEST(halfedge_extraction_pairs_like_radix_pairing) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 8.0f, 1200);
+    GridDescriptor grid = get_test_grid(points, 1.0f);
+    std::vector<int> scalar_values = calculate_distance_field<int>(grid, points, 1);
+    VertexClassification classification = classify_grid_vertices(scalar_values, 1);
+    IndexedMesh surface = query_case_table(classification, scalar_values, grid, 1.0f);
+    HalfEdgeMesh extracted = query_case_table_halfedge(classification, scalar_values, grid, 1.0f);
+    HalfEdgeMesh paired(surface.positions, surface.face_indices);
+    CHECK(extracted.faces == paired.faces);
+    CHECK(extracted.halfedges_vertex_to == paired.halfedges_vertex_to);
+    CHECK(extracted.halfedges_opposite == paired.halfedges_opposite);
+}
+
+namespace {
+    /* Closed double cone: a ring of n_ring vertices around the z axis, joined to an apex above and one below (vertices 0 and 1).
+     * Each apex has n_ring neighbours, every ring vertex 4 */
+    HalfEdgeMesh get_double_cone(unsigned int const& n_ring) {
+        std::vector<glm::vec3> positions = {glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)};
+        std::vector<unsigned int> faces;
+        for(unsigned int n = 0; n < n_ring; n++) {
+            float angle = 2.0f * 3.14159265f * n / n_ring;
+            positions.emplace_back(std::cos(angle), std::sin(angle), 0.0f);
+            unsigned int current = 2 + n;
+            unsigned int next = 2 + (n + 1) % n_ring;
+            faces.insert(faces.end(), {0, current, next, 1, next, current});
+        }
+        return HalfEdgeMesh(positions, faces);
+    }
+
+    /* Checks every link of a compacted mesh: other halves are mutual and go the other way, every vertex has an outgoing halfedge
+     * that starts at it, and the surface is a closed manifold with the given Euler characteristic (V - E + F, 2 per sphere) */
+    void check_closed_mesh(HalfEdgeMesh& mesh, int const& euler_characteristic = 2) {
+        CHECK(mesh.deleted_faces.empty() && mesh.deleted_vertices.empty());
+        CHECK(mesh.faces.size() == mesh.halfedges_vertex_to.size() && mesh.faces.size() == mesh.halfedges_opposite.size());
+        bool halves_match = true;
+        for(unsigned int halfedge = 0; halfedge < mesh.halfedges_opposite.size(); halfedge++) {
+            int other_half = mesh.halfedges_opposite[halfedge];
+            halves_match = halves_match && other_half >= 0 && mesh.halfedges_opposite[other_half] == (int)halfedge
+                           && mesh.halfedges_vertex_to[other_half] == mesh.get_vertex_from(halfedge)
+                           && mesh.get_face(other_half) != mesh.get_face(halfedge);
+        }
+        CHECK(halves_match);
+        bool outgoing_valid = true;
+        for(unsigned int vertex = 0; vertex < mesh.vertex_positions.size(); vertex++) {
+            int outgoing = mesh.vertex_outgoing_halfedge[vertex];
+            outgoing_valid = outgoing_valid && outgoing >= 0 && mesh.get_vertex_from(outgoing) == (int)vertex;
+        }
+        CHECK(outgoing_valid);
+        CHECK(mesh.check_manifold());
+        std::size_t n_faces = mesh.faces.size() / 3;
+        CHECK((long)mesh.vertex_positions.size() - (long)(3 * n_faces / 2) + (long)n_faces == euler_characteristic);
+    }
+}
+
+TEST(remeshing_double_cone_keeps_closed_mesh) {
+    // The apex valences shrink as the ring is collapsed. Collapses that would leave a vertex with two neighbours, two faces
+    // on the same three vertices, or flatten a tetrahedron must be refused
+    for(unsigned int n_ring : {17u, 30u}) {
+        for(float target_edge_length : {0.6f, 1.0f, 2.0f}) {
+            for(bool use_priority_queue : {false, true}) {
+                HalfEdgeMesh mesh = get_double_cone(n_ring);
+                check_closed_mesh(mesh);
+                mesh.remesh(target_edge_length, 3, use_priority_queue);
+                mesh.compact();
+                CHECK(mesh.vertex_positions.size() >= 4);
+                check_closed_mesh(mesh);
+            }
+        }
+    }
+}
+
+TEST(compact_matches_rebuild_from_surviving_faces) {
+    IndexedMesh surface = get_sphere_surface(8.0f, 1.0f);
+    HalfEdgeMesh mesh(surface.positions, surface.face_indices);
+    float const high = 4.0f / 3.0f * mesh.get_mean_edge_length();
+    unsigned int n_collapsed = 0;
+    for(unsigned int halfedge = 0; halfedge < mesh.halfedges_vertex_to.size() && n_collapsed < 40; halfedge += 97) {
+        if(mesh.halfedges_vertex_to[halfedge] == -1) continue;
+        n_collapsed += mesh.edge_collapse(halfedge, high);
+    }
+    CHECK(n_collapsed > 0 && mesh.deleted_faces.size() == 2 * n_collapsed && mesh.deleted_vertices.size() == n_collapsed);
+
+    // Reference: the faces still in the mesh, with their vertices renumbered in order, paired from scratch
+    std::vector<int> vertex_remap(mesh.vertex_positions.size(), 0);
+    for(unsigned int const& vertex : mesh.deleted_vertices) vertex_remap[vertex] = -1;
+    std::vector<glm::vec3> positions;
+    for(unsigned int vertex = 0; vertex < vertex_remap.size(); vertex++) {
+        if(vertex_remap[vertex] == -1) continue;
+        vertex_remap[vertex] = positions.size();
+        positions.push_back(mesh.vertex_positions[vertex]);
+    }
+    std::vector<unsigned int> faces;
+    for(unsigned int const& vertex : mesh.faces) {
+        if(vertex != (unsigned int)-1) faces.push_back(vertex_remap[vertex]);
+    }
+    HalfEdgeMesh rebuilt(positions, faces);
+
+    mesh.compact();
+    CHECK(mesh.vertex_positions == rebuilt.vertex_positions);
+    CHECK(mesh.faces == rebuilt.faces);
+    CHECK(mesh.halfedges_vertex_to == rebuilt.halfedges_vertex_to);
+    CHECK(mesh.halfedges_opposite == rebuilt.halfedges_opposite);
+    check_closed_mesh(mesh, 4); // The offset surface of a sphere point cloud has an inner and an outer sphere
+}
@@ -0,0 +1,76 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../marching_cubes/incremental_distance_field.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Grid indices where the two fields differ, sorted
+    std::vector<std::size_t> get_differences(std::vector<int> const& before, std::vector<int> const& after) {
+        std::vector<std::size_t> differences;
+        for(std::size_t vertex = 0; vertex < before.size(); vertex++) {
+            if(before[vertex] != after[vertex]) differences.push_back(vertex);
+        }
+        return differences;
+    }
+}
+
+TEST(incremental_distance_field_matches_clamped_full_field) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 10.0f, 500);
+    GridDescriptor grid = get_test_grid(points, 1.0f);
+    IncrementalDistanceField field = create_incremental_distance_field(grid, points, 1, 1);
+    std::vector<int> full = calculate_distance_field<int>(grid, KDTree(points), 1);
+    bool same = true;
+    for(std::size_t vertex = 0; vertex < full.size(); vertex++) {
+        same = same && field.scalar_values[vertex] == std::min(full[vertex], field.max_distance);
+    }
+    CHECK(same);
+}
+
+TEST(incremental_insert_matches_rebuild) {
+    std::vector<glm::vec3> sphere = get_sphere_points(glm::vec3(0.0f), 10.0f, 600);
+    std::vector<glm::vec3> initial(sphere.begin(), sphere.begin() + 400);
+    std::vector<glm::vec3> added(sphere.begin() + 400, sphere.end());
+    GridDescriptor grid = get_test_grid(sphere, 1.0f);
+
+    IncrementalDistanceField field = create_incremental_distance_field(grid, initial, 1, 1);
+    std::vector<int> before = field.scalar_values;
+    DistanceFieldUpdate update = insert_points(field, added);
+    CHECK(field.scalar_values == create_incremental_distance_field(grid, sphere, 1, 1).scalar_values);
+    CHECK(update.changed_vertices == get_differences(before, field.scalar_values));
+    CHECK(std::is_sorted(update.dirty_cells.begin(), update.dirty_cells.end()));
+}
+
+TEST(incremental_remove_matches_rebuild) {
+    std::vector<glm::vec3> sphere = get_sphere_points(glm::vec3(0.0f), 10.0f, 600);
+    std::vector<glm::vec3> removed, kept;
+    for(std::size_t point = 0; point < sphere.size(); point++) {
+        (point % 3 == 0 ? removed : kept).push_back(sphere[point]);
+    }
+    GridDescriptor grid = get_test_grid(sphere, 1.0f);
+
+    for(unsigned int n_threads : {1u, 4u}) {
+        IncrementalDistanceField field = create_incremental_distance_field(grid, sphere, 1, n_threads);
+        std::vector<int> before = field.scalar_values;
+        DistanceFieldUpdate update = remove_points(field, removed, n_threads);
+        CHECK(field.points.size() == kept.size());
+        CHECK(field.scalar_values == create_incremental_distance_field(grid, kept, 1, 1).scalar_values);
+        CHECK(update.changed_vertices == get_differences(before, field.scalar_values));
+    }
+}
+
+TEST(incremental_insert_then_remove_restores_field) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 10.0f, 400);
+    std::vector<glm::vec3> scan = get_random_points(glm::vec3(-4.0f), glm::vec3(4.0f), 50, 3);
+    GridDescriptor grid = get_test_grid(points, 1.0f);
+
+    IncrementalDistanceField field = create_incremental_distance_field(grid, points, 1, 1);
+    std::vector<int> original = field.scalar_values;
+    insert_points(field, scan);
+    CHECK(field.scalar_values != original);
+    remove_points(field, scan, 1);
+    CHECK(field.scalar_values == original);
+}
@@ -0,0 +1,86 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../incremental_remeshing/halfedge.hpp"
+#include "../incremental_remeshing/small_vector.hpp"
+
+#include <vector>
+#include <cmath>
+
+namespace {
+    // One ring collected into a std::vector with the do-while walk the circulator replaced
+    std::vector<unsigned int> get_reference_one_ring(HalfEdgeMesh& mesh, unsigned int const& vertex) {
+        std::vector<unsigned int> one_ring;
+        int const first = mesh.vertex_outgoing_halfedge[vertex];
+        int halfedge = first;
+        do {
+            one_ring.push_back(mesh.halfedges_vertex_to[halfedge]);
+            halfedge = mesh.halfedges_opposite[mesh.get_previous_halfedge(halfedge)];
+        } while(halfedge != first && halfedge != -1);
+        return one_ring;
+    }
+
+    // Closed fan around vertex 0 with n_neighbours neighbours, closed below by vertex 1
+    HalfEdgeMesh get_fan(unsigned int const& n_neighbours) {
+        std::vector<glm::vec3> positions = {glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)};
+        std::vector<unsigned int> faces;
+        for(unsigned int n = 0; n < n_neighbours; n++) {
+            float angle = 2.0f * 3.14159265f * n / n_neighbours;
+            positions.emplace_back(std::cos(angle), std::sin(angle), 0.0f);
+            unsigned int next = 2 + (n + 1) % n_neighbours;
+            faces.insert(faces.end(), {0, 2 + n, next, 1, next, 2 + n});
+        }
+        return HalfEdgeMesh(positions, faces);
+    }
+
+    void check_one_rings_match_reference(HalfEdgeMesh& mesh) {
+        std::vector<unsigned int> halfedges_from(mesh.vertex_positions.size(), 0);
+        for(unsigned int halfedge = 0; halfedge < mesh.halfedges_vertex_to.size(); halfedge++) {
+            halfedges_from[mesh.get_vertex_from(halfedge)]++;
+        }
+        OneRingAdjacency adjacency = mesh.get_one_ring_adjacency(1);
+        OneRingAdjacency threaded_adjacency = mesh.get_one_ring_adjacency(4);
+        bool same = true;
+        for(unsigned int vertex = 0; vertex < mesh.vertex_positions.size(); vertex++) {
+            std::vector<unsigned int> expected = get_reference_one_ring(mesh, vertex);
+            OneRing one_ring = mesh.get_one_ring_vertices(vertex);
+            same = same && std::vector<unsigned int>(one_ring.begin(), one_ring.end()) == expected;
+            same = same && mesh.get_valence(vertex) == expected.size() && halfedges_from[vertex] == expected.size();
+            same = same && std::vector<unsigned int>(adjacency.neighbours.begin() + adjacency.offsets[vertex],
+                                                     adjacency.neighbours.begin() + adjacency.offsets[vertex + 1]) == expected;
+        }
+        CHECK(same);
+        CHECK(threaded_adjacency.offsets == adjacency.offsets && threaded_adjacency.neighbours == adjacency.neighbours);
+    }
+}
+
+TEST(small_vector_spills_to_heap) {
+    SmallVector<unsigned int, 4> values;
+    std::vector<unsigned int> expected;
+    for(unsigned int value = 0; value < 20; value++) {
+        values.push_back(value * 3);
+        expected.push_back(value * 3);
+        CHECK(std::vector<unsigned int>(values.begin(), values.end()) == expected);
+    }
+    values.clear();
+    CHECK(values.empty());
+    values.push_back(7);
+    CHECK(values.size() == 1 && values[0] == 7);
+}
+
+TEST(circulator_one_rings_match_reference) {
+    IndexedMesh surface = get_sphere_surface(8.0f, 1.0f);
+    HalfEdgeMesh mesh(surface.positions, surface.face_indices);
+    check_one_rings_match_reference(mesh);
+}
+
+TEST(circulator_one_rings_past_inline_capacity_match_reference) {
+    // The apexes have more neighbours than a OneRing stores inline
+    for(unsigned int n_neighbours : {ONE_RING_CAPACITY - 1, ONE_RING_CAPACITY, ONE_RING_CAPACITY + 1, 3 * ONE_RING_CAPACITY}) {
+        HalfEdgeMesh mesh = get_fan(n_neighbours);
+        CHECK(mesh.get_valence(0) == n_neighbours);
+        check_one_rings_match_reference(mesh);
+    }
+}
@@ -0,0 +1,82 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../marching_cubes/parallel.hpp"
+#include "../marching_cubes/distance_field.hpp"
+#include "../marching_cubes/kd_tree.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+TEST(parallel_for_slabs_runs_every_slab_once) {
+    // Repeated calls with growing and shrinking thread counts reuse the same pool
+    for(int repeat = 0; repeat < 3; repeat++) {
+        for(unsigned int n_threads : {1u, 2u, 4u, 7u, 3u}) {
+            std::vector<std::atomic<int>> visits(1000);
+            parallel_for_slabs(visits.size(), n_threads, [&](unsigned int slab) { visits[slab]++; });
+            bool once = true;
+            for(auto const& count : visits) once = once && count == 1;
+            CHECK(once);
+        }
+    }
+}
+
+TEST(parallel_for_slabs_nested_call_runs_inline) {
+    std::vector<std::atomic<int>> visits(16 * 16);
+    parallel_for_slabs(16, 4, [&](unsigned int outer) {
+        parallel_for_slabs(16, 4, [&](unsigned int inner) { visits[outer * 16 + inner]++; });
+    });
+    bool once = true;
+    for(auto const& count : visits) once = once && count == 1;
+    CHECK(once);
+}
+
+namespace {
+    // Runs parallel_for_slabs and returns whether it threw
+    template<typename Task>
+    bool throws(unsigned int const& n_slabs, unsigned int const& n_threads, Task const& task) {
+        try {
+            parallel_for_slabs(n_slabs, n_threads, task);
+        } catch(std::runtime_error const&) {
+            return true;
+        }
+        return false;
+    }
+}
+
+TEST(parallel_for_slabs_rethrows_and_frees_pool) {
+    std::thread::id const caller = std::this_thread::get_id();
+    // Thrown on the calling thread, and on a helper thread (the other threads are slowed down so they cannot take every slab)
+    CHECK(throws(64, 4, [&](unsigned int) {
+        if(std::this_thread::get_id() == caller) throw std::runtime_error("caller");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }));
+    CHECK(throws(64, 4, [&](unsigned int) {
+        if(std::this_thread::get_id() != caller) throw std::runtime_error("helper");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }));
+    CHECK(throws(64, 4, [](unsigned int) { throw std::runtime_error("every thread"); }));
+
+    // The pool is free again, so later calls still run on it and visit every slab
+    CHECK(WorkerPool::get().run(3, []() {}));
+    std::vector<std::atomic<int>> visits(1000);
+    parallel_for_slabs(visits.size(), 4, [&](unsigned int slab) { visits[slab]++; });
+    bool once = true;
+    for(auto const& count : visits) once = once && count == 1;
+    CHECK(once);
+}
+
+TEST(multi_threaded_distance_field_matches_single_threaded) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 10.0f, 600);
+    GridDescriptor grid = get_test_grid(points, 0.5f);
+    KDTree tree(points);
+    int isovalue = 1;
+    for(auto engine : {DistanceFieldEngine::kd_tree, DistanceFieldEngine::distance_transform, DistanceFieldEngine::classify_first, DistanceFieldEngine::coarse_to_fine}) {
+        std::vector<int> serial = evaluate_distance_field<int>(engine, grid, points, tree, isovalue, 1);
+        CHECK(evaluate_distance_field<int>(engine, grid, points, tree, isovalue, 4) == serial);
+    }
+}
@@ -0,0 +1,125 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../incremental_remeshing/halfedge.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/geometric.hpp>
+
+namespace {
+    float get_max_edge_length(HalfEdgeMesh& mesh) {
+        float max_length = 0.0f;
+        for(unsigned int halfedge = 0; halfedge < mesh.halfedges_vertex_to.size(); halfedge++) {
+            max_length = std::max(max_length, mesh.get_edge_length(halfedge));
+        }
+        return max_length;
+    }
+
+    // Closed two-manifold with other halves in both directions and V - E + F = 4 (the inner and outer sphere of the surface)
+    bool is_closed_sphere_surface(HalfEdgeMesh& mesh) {
+        for(unsigned int halfedge = 0; halfedge < mesh.halfedges_opposite.size(); halfedge++) {
+            int other_half = mesh.halfedges_opposite[halfedge];
+            if(other_half < 0 || mesh.halfedges_opposite[other_half] != (int)halfedge) return false;
+        }
+        std::size_t n_faces = mesh.faces.size() / 3;
+        return mesh.check_manifold() && (long)mesh.vertex_positions.size() - (long)(3 * n_faces / 2) + (long)n_faces == 4;
+    }
+
+    HalfEdgeMesh get_sphere_mesh() {
+        IndexedMesh surface = get_sphere_surface(8.0f, 1.0f);
+        return HalfEdgeMesh(surface.positions, surface.face_indices);
+    }
+}
+
+TEST(queued_split_leaves_no_long_edges) {
+    HalfEdgeMesh mesh = get_sphere_mesh();
+    HalfEdgeMesh linear = mesh;
+    float const mean_edge_length = mesh.get_mean_edge_length();
+    float const high = 0.8f * mean_edge_length;
+    std::size_t const n_vertices = mesh.vertex_positions.size();
+
+    unsigned int n_splits = mesh.split_long_edges_queued(high);
+    CHECK(n_splits > 0 && mesh.vertex_positions.size() == n_vertices + n_splits);
+    CHECK(get_max_edge_length(mesh) < high);
+    CHECK(is_closed_sphere_surface(mesh));
+
+    // The linear pass it replaces gives a mesh with the same guarantees. It is run at the mean edge length: splitting
+    // edges in index order does not always split the longest edge of a face, and well below the mean edge length of this
+    // surface it keeps making long edges and never stops
+    linear.split_long_edges(mean_edge_length);
+    CHECK(get_max_edge_length(linear) < mean_edge_length);
+    CHECK(is_closed_sphere_surface(linear));
+}
+
+TEST(queued_collapse_keeps_closed_mesh) {
+    HalfEdgeMesh mesh = get_sphere_mesh();
+    float const target = 1.5f * mesh.get_mean_edge_length();
+    float const high = 4.0f / 3.0f * target;
+    float const max_before = get_max_edge_length(mesh);
+    std::size_t const n_vertices = mesh.vertex_positions.size();
+
+    unsigned int n_collapses = mesh.collapse_short_edges_queued(high, 4.0f / 5.0f * target);
+    CHECK(n_collapses > 0 && mesh.vertex_positions.size() == n_vertices - n_collapses);
+    CHECK(mesh.deleted_faces.empty() && mesh.deleted_vertices.empty());
+    CHECK(get_max_edge_length(mesh) < std::max(high, max_before)); // No collapse creates an edge of high length or more
+    CHECK(is_closed_sphere_surface(mesh));
+}
+
+TEST(queued_remeshing_matches_linear_remeshing) {
+    HalfEdgeMesh queued = get_sphere_mesh();
+    HalfEdgeMesh linear = queued;
+    float const target = queued.get_mean_edge_length();
+    queued.remesh(target, 3, true);
+    linear.remesh(target, 3, false);
+    CHECK(is_closed_sphere_surface(queued));
+    CHECK(is_closed_sphere_surface(linear));
+    // Both converge to edges close to the target (the passes visit edges in a different order, so the meshes differ)
+    CHECK(std::abs(queued.get_mean_edge_length() - target) < 0.15f * target);
+    CHECK(std::abs(linear.get_mean_edge_length() - target) < 0.15f * target);
+}
+
+TEST(jacobi_relaxation_matches_reference_on_any_thread_count) {
+    HalfEdgeMesh mesh = get_sphere_mesh();
+    mesh.remesh(0.0f, 1);
+    mesh.calculate_normals();
+
+    // Reference: every vertex moves from the positions before the sweep, with its one ring from the circulator
+    std::vector<glm::vec3> expected(mesh.vertex_positions.size());
+    for(unsigned int vertex_idx = 0; vertex_idx < mesh.vertex_positions.size(); vertex_idx++) {
+        glm::vec3 barycentre = glm::vec3{0.0f, 0.0f, 0.0f};
+        OneRing const one_ring = mesh.get_one_ring_vertices(vertex_idx);
+        for(unsigned int const vertex : one_ring) {
+            barycentre += mesh.vertex_positions[vertex];
+        }
+        barycentre /= (float)one_ring.size();
+        glm::vec3 const& normal = mesh.vertex_normals[vertex_idx];
+        expected[vertex_idx] = barycentre + glm::dot(normal, mesh.vertex_positions[vertex_idx] - barycentre) * normal;
+    }
+
+    HalfEdgeMesh single_threaded = mesh;
+    single_threaded.tangential_relaxation_jacobi(1);
+    float max_error = 0.0f;
+    for(unsigned int vertex_idx = 0; vertex_idx < expected.size(); vertex_idx++) {
+        max_error = std::max(max_error, glm::distance(single_threaded.vertex_positions[vertex_idx], expected[vertex_idx]));
+    }
+    CHECK(max_error < 1e-4f);
+
+    // Vertices only read the old positions, so the thread count does not change a single bit
+    for(unsigned int const n_threads : {2u, 4u, 7u}) {
+        HalfEdgeMesh multi_threaded = mesh;
+        multi_threaded.tangential_relaxation_jacobi(n_threads);
+        CHECK(multi_threaded.vertex_positions == single_threaded.vertex_positions);
+    }
+}
+
+TEST(jacobi_remeshing_keeps_closed_mesh) {
+    HalfEdgeMesh mesh = get_sphere_mesh();
+    float const target = mesh.get_mean_edge_length();
+    mesh.remesh(target, 3, true, true, 4);
+    CHECK(is_closed_sphere_surface(mesh));
+    CHECK(std::abs(mesh.get_mean_edge_length() - target) < 0.15f * target);
+}
@@ -0,0 +1,150 @@
+//
+// Created by Carolina Cuadra Pardo on 10/17/26.
+//
+
+#include "test_common.hpp"
+#include "../marching_cubes/surface_reconstruction.hpp"
+#include "../marching_cubes/kd_tree.hpp"
+
+#include <array>
+#include <algorithm>
+#include <tuple>
+
+namespace {
+    using Triangle = std::array<glm::vec3, 3>;
+
+    bool position_less(glm::vec3 const& a, glm::vec3 const& b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    }
+
+    /* Triangles of the mesh by vertex position, each rotated to start at its smallest corner (keeps the orientation), sorted.
+     * Equal for two meshes with the same triangles whatever order the vertices are numbered in */
+    std::vector<Triangle> get_triangles(IndexedMesh const& mesh) {
+        std::vector<Triangle> triangles;
+        for(std::size_t face = 0; face < mesh.face_indices.size() / 3; face++) {
+            Triangle triangle;
+            for(int n = 0; n < 3; n++) triangle[n] = mesh.positions[mesh.face_indices[3 * face + n]];
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end(), position_less), triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end(), [](Triangle const& a, Triangle const& b) {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), position_less);
+        });
+        return triangles;
+    }
+
+    struct TestField {
+        GridDescriptor grid;
+        std::vector<int> scalar_values;
+    };
+
+    // Distance field of a sphere. extra_x grows the grid along +i, so the slabs past the sphere are empty
+    TestField get_sphere_field(float const& grid_resolution, float const& extra_x = 0.0f) {
+        std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 10.0f, 1500);
+        BoundingBox bbox = get_bounding_box(points);
+        bbox.add_padding(0.25f);
+        bbox.max.x += extra_x;
+        GridDescriptor grid = get_grid_descriptor(grid_resolution, bbox);
+        return {grid, calculate_distance_field<int>(grid, KDTree(points), 1)};
+    }
+
+    bool same_mesh(IndexedMesh const& a, IndexedMesh const& b) {
+        return a.positions == b.positions && a.face_indices == b.face_indices;
+    }
+}
+
+TEST(multi_threaded_query_case_table_matches_serial) {
+    TestField field = get_sphere_field(1.0f);
+    VertexClassification classification = classify_grid_vertices(field.scalar_values, 1);
+    IndexedMesh serial = query_case_table(classification, field.scalar_values, field.grid, 1.0f, 1);
+    CHECK(!serial.face_indices.empty());
+    for(unsigned int n_threads : {2u, 4u, 16u}) {
+        CHECK(same_mesh(query_case_table(classification, field.scalar_values, field.grid, 1.0f, n_threads), serial));
+    }
+}
+
+TEST(two_pass_query_case_table_matches_serial) {
+    // The wide grid leaves empty slabs after the last triangle
+    for(float extra_x : {0.0f, 15.0f}) {
+        TestField field = get_sphere_field(1.0f, extra_x);
+        VertexClassification classification = classify_grid_vertices(field.scalar_values, 1);
+        IndexedMesh serial = query_case_table(classification, field.scalar_values, field.grid, 1.0f, 1);
+        std::vector<Triangle> expected = get_triangles(serial);
+        for(unsigned int n_threads : {1u, 3u, 8u}) {
+            IndexedMesh two_pass = query_case_table_two_pass(classification, field.scalar_values, field.grid, 1.0f, n_threads);
+            CHECK(two_pass.positions.size() == serial.positions.size());
+            CHECK(get_triangles(two_pass) == expected);
+        }
+    }
+}
+
+TEST(query_case_table_without_surface_is_empty) {
+    TestField field = get_sphere_field(1.0f);
+    VertexClassification classification = classify_grid_vertices(field.scalar_values, -1); // Every vertex is positive
+    for(unsigned int n_threads : {1u, 4u}) {
+        IndexedMesh mesh = query_case_table(classification, field.scalar_values, field.grid, -1.0f, n_threads);
+        CHECK(mesh.positions.empty() && mesh.face_indices.empty());
+        IndexedMesh two_pass = query_case_table_two_pass(classification, field.scalar_values, field.grid, -1.0f, n_threads);
+        CHECK(two_pass.positions.empty() && two_pass.face_indices.empty());
+    }
+}
+
+/* The sparse grid must give the same triangles as the dense grid from the same points. Large isovalues put the surface close
+ * to the edge of the band, where cubes reach into blocks that are not allocated and read the background value */
+TEST(sparse_query_case_table_matches_dense) {
+    std::vector<glm::vec3> points = get_sphere_points(glm::vec3(0.0f), 12.0f, 1500);
+    std::vector<glm::vec3> scattered = get_random_points(glm::vec3(-20.0f), glm::vec3(20.0f), 40, 5);
+    points.insert(points.end(), scattered.begin(), scattered.end());
+    KDTree tree(points);
+    for(float grid_resolution : {1.0f, 2.0f}) {
+        GridDescriptor descriptor = get_test_grid(points, grid_resolution, 0.5f);
+        std::vector<int> scalar_values = calculate_distance_field<int>(descriptor, tree, 1);
+        for(int isovalue : {1, 3, 7}) {
+            IndexedMesh dense = query_case_table(classify_grid_vertices(scalar_values, isovalue), scalar_values, descriptor,
+                                                 (float)isovalue);
+            SparseGrid grid = create_sparse_grid(points, descriptor, isovalue);
+            calculate_distance_field(grid, tree, 2);
+            classify_grid_vertices(grid, isovalue);
+            IndexedMesh sparse = query_case_table(grid, (float)isovalue);
+            CHECK(!dense.face_indices.empty());
+            CHECK(sparse.positions.size() == dense.positions.size());
+            CHECK(get_triangles(sparse) == get_triangles(dense));
+        }
+    }
+}
+
+/* Moves the block mesh store through isovalues going up and down. At every step its mesh must have the triangles and the
+ * vertex count of the dense mesh extracted from scratch at that isovalue */
+TEST(block_mesh_store_updates_match_dense) {
+    TestField field = get_sphere_field(1.0f);
+    for(unsigned int n_threads : {1u, 4u}) {
+        BlockMeshStore store = create_block_mesh_store(classify_grid_vertices(field.scalar_values, 1), field.grid, 1, n_threads);
+        for(int isovalue : {1, 3, 2, 5, 1}) {
+            VertexClassification classification = classify_grid_vertices(field.scalar_values, isovalue);
+            std::size_t n_marched = update_isovalue(store, classification, isovalue, n_threads);
+            CHECK(store.isovalue == isovalue);
+            CHECK(n_marched <= store.blocks.size());
+            IndexedMesh expected = query_case_table(classification, field.scalar_values, field.grid, (float)isovalue);
+            IndexedMesh mesh = query_case_table(store, field.scalar_values, n_threads);
+            CHECK(!expected.face_indices.empty());
+            CHECK(mesh.positions.size() == expected.positions.size());
+            CHECK(get_triangles(mesh) == get_triangles(expected));
+        }
+    }
+}
+
+TEST(batch_query_case_table_matches_single_isovalue) {
+    TestField field = get_sphere_field(1.0f);
+    std::vector<int> const isovalues = {1, 3, 2, 5}; // Not sorted, results must come back in this order
+    for(unsigned int n_threads : {1u, 4u}) {
+        std::vector<IndexedMesh> batch = query_case_table_batch(field.scalar_values, field.grid, isovalues, n_threads);
+        CHECK(batch.size() == isovalues.size());
+        for(std::size_t n = 0; n < std::min(batch.size(), isovalues.size()); n++) {
+            IndexedMesh expected = query_case_table(classify_grid_vertices(field.scalar_values, isovalues[n]), field.scalar_values,
+                                                    field.grid, (float)isovalues[n]);
+            CHECK(!expected.face_indices.empty());
+            CHECK(batch[n].positions.size() == expected.positions.size());
+            CHECK(get_triangles(batch[n]) == get_triangles(expected));
+        }
+    }
+}